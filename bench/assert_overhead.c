@@ -0,0 +1,89 @@
+/***********************************************************************************************************************
+ *
+ * @file        assert_overhead.c
+ * @brief       Micro-benchmark of the cost of a passing assertion in a hot loop, compared to a bare if.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include <ctest/ctest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Number of values every benchmark checks per operation.
+ */
+#define VALUE_COUNT 4096
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Values checked by the benchmarks, filled at startup so the compiler cannot prove the checks pass.
+ */
+static int values[VALUE_COUNT];
+
+/**
+ * @brief   Number of values the benchmarks found negative, stays 0.
+ */
+static int negative_count;
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+__attribute__((constructor)) static void fill_values(void)
+{
+    uint32_t state = 1;
+    for (int i = 0; i < VALUE_COUNT; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        values[i] = (int)(state >> 8);
+    }
+}
+
+__attribute__((cold, noinline)) static void report_negative(int index, int value)
+{
+    fprintf(stderr, "values[%d] = %d\n", index, value);
+    negative_count++;
+}
+
+// --- Benchmarks ------------------------------------------------------------------------------------------------------
+
+// Previous form of the assertion, a variadic call on every check whether it passes or not. Runs first, so the CPU
+// has left its idle state by the time the other two are compared.
+CTEST_BENCH(assert_overhead_call, {
+    for (int i = 0; i < VALUE_COUNT; i++)
+    {
+        if (!ctest__assert(values[i] >= 0, "values[i] >= 0", __FILE__, __FUNCTION__, __LINE__, "values[%d] = %d", i,
+                           values[i]))
+            failed_assertions++;
+    }
+})
+
+// Baseline, the check every assertion has to make with the reporting moved out of line
+CTEST_BENCH(assert_overhead_bare_if, {
+    for (int i = 0; i < VALUE_COUNT; i++)
+    {
+        if (__builtin_expect(values[i] < 0, 0))
+            report_negative(i, values[i]);
+    }
+})
+
+// Assertion as the tests write it, expected within a few percent of the bare if
+CTEST_BENCH(assert_overhead_assert, {
+    for (int i = 0; i < VALUE_COUNT; i++)
+        CTEST_ASSERT_MSG(values[i] >= 0, "values[%d] = %d", i, values[i]);
+})
+
+CTEST_TEST(assert_overhead_values, {
+    CTEST_ASSERT_EQ(negative_count, 0);
+})
+
+CTEST_RUN_TESTS()
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -15,6 +15,7 @@
  
  #include <stdarg.h>
  #include <stdbool.h>
+ #include <stdint.h>
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
@@ -31,48 +32,432 @@
  #define CTEST_GRN  "\e[1;32m"
  #define CTEST_RST  "\e[0m"
  
+ /**
+  * @brief   Linker section collecting the descriptors of all tests.
+  */
+ #if defined(__APPLE__) && !defined(ESP_PLATFORM)
+ #define CTEST__SECTION "__DATA,ctest_tests"
+ #else
+ #define CTEST__SECTION "ctest_tests"
+ #endif // Linker section
+ 
+ /**
+  * @brief   Marks a condition as unlikely, so the compiler lays out the code of a passing assertion as straight-line
+  *          code and moves the failure handling out of the hot path.
+  */
+ #define CTEST__UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+ 
+ /**
+  * @brief   Type of an expression, the expression itself is not evaluated.
+  */
+ #ifdef __cplusplus
+ #define CTEST__TYPEOF(expression) decltype(expression)
+ #else
+ #define CTEST__TYPEOF(expression) __typeof__(expression)
+ #endif // __cplusplus
+ 
  // --- Public Macros ---------------------------------------------------------------------------------------------------
  
  /**
   * @brief   Macro that evaluates a condition and increments the failed_assertions counter if the assertion fails, while
   *          logging the condition, file, function, and line number.
   */
- #define CTEST_ASSERT(condition)                                                                                        \
-     failed_assertions += !ctest__assert((condition), #condition, __FILE__, __FUNCTION__, __LINE__, "") ? 1 : 0
+ #define CTEST_ASSERT(condition) CTEST__ASSERT(condition, #condition, "")
  
  /**
   * @brief   Macro that evaluates a condition and increments the failed_assertions counter if the assertion fails,
   *          logging the condition, file, function, line number, and an optional custom message with additional
-  *          arguments.
+  *          arguments. A passing assertion costs a single predicted branch, the reporting is done out of line. The
+  *          message arguments are evaluated and formatted only when the assertion fails.
+  */
+ #define CTEST_ASSERT_MSG(condition, msg, ...) CTEST__ASSERT(condition, #condition, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Implements CTEST_ASSERT and CTEST_ASSERT_MSG. The source text is stringified by the public macros, before
+  *          macros such as NULL in the condition are expanded.
   */
- #define CTEST_ASSERT_MSG(condition, msg, ...)                                                                          \
-     failed_assertions +=                                                                                               \
-         !ctest__assert((condition), #condition, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__) ? 1 : 0
+ #define CTEST__ASSERT(condition, text, msg, ...)                                                                       \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         if (CTEST__UNLIKELY(!(condition)))                                                                             \
+         {                                                                                                              \
+             ctest__fail(text, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__);                                   \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
+ 
+ /**
+  * @brief   Captures an operand of a comparison assertion as a typed value, evaluating it exactly once. Integers keep
+  *          their signedness, floating point values are widened to double and anything else is taken as a pointer.
+  */
+ #ifdef __cplusplus
+ #define CTEST__VALUE(value) ctest__make_value(value)
+ #else
+ #define CTEST__VALUE(value)                                                                                            \
+     _Generic((value),                                                                                                  \
+         _Bool: ctest__value_unsigned,                                                                                  \
+         char: ctest__value_signed,                                                                                     \
+         signed char: ctest__value_signed,                                                                              \
+         short: ctest__value_signed,                                                                                    \
+         int: ctest__value_signed,                                                                                      \
+         long: ctest__value_signed,                                                                                     \
+         long long: ctest__value_signed,                                                                                \
+         unsigned char: ctest__value_unsigned,                                                                          \
+         unsigned short: ctest__value_unsigned,                                                                         \
+         unsigned int: ctest__value_unsigned,                                                                           \
+         unsigned long: ctest__value_unsigned,                                                                          \
+         unsigned long long: ctest__value_unsigned,                                                                     \
+         float: ctest__value_double,                                                                                    \
+         double: ctest__value_double,                                                                                   \
+         long double: ctest__value_double,                                                                              \
+         default: ctest__value_pointer)(value)
+ #endif // __cplusplus
+ 
+ /**
+  * @brief   Compares two operands with the given operator, printing the source and the value of both operands if the
+  *          assertion fails. Mixed signed and unsigned operands are compared by their mathematical value. The source
+  *          text of the operands is stringified by the public macros.
+  */
+ #define CTEST__ASSERT_COMPARE(a, b, a_text, b_text, op, op_text, msg, ...)                                             \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const ctest__value_t ctest__left = CTEST__VALUE(a);                                                            \
+         const ctest__value_t ctest__right = CTEST__VALUE(b);                                                           \
+         if (CTEST__UNLIKELY(!ctest__compare(ctest__left, ctest__right, op)))                                           \
+         {                                                                                                              \
+             ctest__fail_compare(a_text " " op_text " " b_text, a_text, b_text, ctest__left, ctest__right, __FILE__,    \
+                                 __FUNCTION__, __LINE__, msg, ##__VA_ARGS__);                                           \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
  
  /**
   * @brief   Asserts that two values are equal.
   */
- #define CTEST_ASSERT_EQ(a, b) CTEST_ASSERT((a) == (b))
+ #define CTEST_ASSERT_EQ(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__EQ, "==", "")
  
  /**
   * @brief   Asserts that two values are equal with a custom message.
   */
- #define CTEST_ASSERT_EQ_MSG(a, b, msg, ...) CTEST_ASSERT_MSG((a) == (b), msg, ##__VA_ARGS__)
+ #define CTEST_ASSERT_EQ_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__EQ, "==", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that two values are not equal.
+  */
+ #define CTEST_ASSERT_NE(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__NE, "!=", "")
+ 
+ /**
+  * @brief   Asserts that two values are not equal with a custom message.
+  */
+ #define CTEST_ASSERT_NE_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__NE, "!=", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that the first value is less than the second.
+  */
+ #define CTEST_ASSERT_LT(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__LT, "<", "")
+ 
+ /**
+  * @brief   Asserts that the first value is less than the second with a custom message.
+  */
+ #define CTEST_ASSERT_LT_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__LT, "<", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that the first value is less than or equal to the second.
+  */
+ #define CTEST_ASSERT_LE(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__LE, "<=", "")
+ 
+ /**
+  * @brief   Asserts that the first value is less than or equal to the second with a custom message.
+  */
+ #define CTEST_ASSERT_LE_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__LE, "<=", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that the first value is greater than the second.
+  */
+ #define CTEST_ASSERT_GT(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__GT, ">", "")
+ 
+ /**
+  * @brief   Asserts that the first value is greater than the second with a custom message.
+  */
+ #define CTEST_ASSERT_GT_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__GT, ">", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that the first value is greater than or equal to the second.
+  */
+ #define CTEST_ASSERT_GE(a, b) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__GE, ">=", "")
  
  /**
-  * @brief   Asserts that two strings are equal.
+  * @brief   Asserts that the first value is greater than or equal to the second with a custom message.
   */
- #define CTEST_ASSERT_EQ_STR(a, b) CTEST_ASSERT(strcmp((a), (b)) == 0)
+ #define CTEST_ASSERT_GE_MSG(a, b, msg, ...) CTEST__ASSERT_COMPARE(a, b, #a, #b, CTEST__GE, ">=", msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that two strings are equal, printing both if they are not. NULL is only equal to NULL.
+  */
+ #define CTEST_ASSERT_EQ_STR(a, b) CTEST__ASSERT_EQ_STR(a, b, #a, #b, "")
  
  /**
   * @brief   Asserts that two strings are equal with a custom message.
   */
- #define CTEST_ASSERT_EQ_STR_MSG(a, b, msg, ...) CTEST_ASSERT_MSG(strcmp((a), (b)) == 0, msg, ##__VA_ARGS__)
+ #define CTEST_ASSERT_EQ_STR_MSG(a, b, msg, ...) CTEST__ASSERT_EQ_STR(a, b, #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Implements CTEST_ASSERT_EQ_STR and CTEST_ASSERT_EQ_STR_MSG.
+  */
+ #define CTEST__ASSERT_EQ_STR(a, b, a_text, b_text, msg, ...)                                                           \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const char *ctest__left = (a);                                                                                 \
+         const char *ctest__right = (b);                                                                                \
+         if (CTEST__UNLIKELY(!ctest__equal_str(ctest__left, ctest__right)))                                             \
+         {                                                                                                              \
+             ctest__fail_str(a_text " == " b_text, a_text, b_text, ctest__left, ctest__right, __FILE__, __FUNCTION__,   \
+                             __LINE__, msg, ##__VA_ARGS__);                                                             \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
+ 
+ /**
+  * @brief   Asserts that two buffers of the given size in bytes are equal. The buffers are compared with a vectorized
+  *          search for their first difference, a failure reports its offset and a hex window of both buffers around it.
+  */
+ #define CTEST_ASSERT_MEM_EQ(a, b, size) CTEST__ASSERT_MEM_EQ(a, b, size, #a, #b, #size, "")
+ 
+ /**
+  * @brief   Asserts that two buffers are equal with a custom message.
+  */
+ #define CTEST_ASSERT_MEM_EQ_MSG(a, b, size, msg, ...)                                                                  \
+     CTEST__ASSERT_MEM_EQ(a, b, size, #a, #b, #size, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Implements CTEST_ASSERT_MEM_EQ and CTEST_ASSERT_MEM_EQ_MSG.
+  */
+ #define CTEST__ASSERT_MEM_EQ(a, b, size, a_text, b_text, size_text, msg, ...)                                          \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const void *ctest__left = (a);                                                                                 \
+         const void *ctest__right = (b);                                                                                \
+         const size_t ctest__size = (size);                                                                             \
+         const size_t ctest__offset = ctest__find_mismatch(ctest__left, ctest__right, ctest__size);                     \
+         if (CTEST__UNLIKELY(ctest__offset != ctest__size))                                                             \
+         {                                                                                                              \
+             ctest__fail_mem("memcmp(" a_text ", " b_text ", " size_text ") == 0", a_text, b_text, ctest__left,         \
+                             ctest__right, ctest__size, ctest__offset, __FILE__, __FUNCTION__, __LINE__, msg,           \
+                             ##__VA_ARGS__);                                                                            \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
+ 
+ /**
+  * @brief   Asserts that two floating point values differ by at most the given absolute tolerance. Values are compared
+  *          as float when both are float and as double otherwise, equal values always pass and NaN never does. An
+  *          infinity is only near an equal infinity.
+  */
+ #define CTEST_ASSERT_NEAR(a, b, tolerance)                                                                             \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_ABS, tolerance),                                   \
+                        "|" #a " - " #b "| <= " #tolerance, #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that two floating point values differ by at most the absolute tolerance with a custom message.
+  */
+ #define CTEST_ASSERT_NEAR_MSG(a, b, tolerance, msg, ...)                                                               \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_ABS, tolerance),                                   \
+                        "|" #a " - " #b "| <= " #tolerance, #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that two floating point values differ by at most the given fraction of the larger magnitude.
+  */
+ #define CTEST_ASSERT_NEAR_REL(a, b, tolerance)                                                                         \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_REL, tolerance),                                   \
+                        "|" #a " - " #b "| <= " #tolerance " * max(|" #a "|, |" #b "|)", #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that two floating point values differ by at most the relative tolerance with a custom message.
+  */
+ #define CTEST_ASSERT_NEAR_REL_MSG(a, b, tolerance, msg, ...)                                                           \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_REL, tolerance),                                   \
+                        "|" #a " - " #b "| <= " #tolerance " * max(|" #a "|, |" #b "|)", #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that at most the given number of representable values lie between two floating point values.
+  */
+ #define CTEST_ASSERT_NEAR_ULP(a, b, ulps)                                                                              \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_ULP, ulps),                                        \
+                        #a " == " #b " within " #ulps " ULPs", #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that two floating point values are at most the given ULPs apart with a custom message.
+  */
+ #define CTEST_ASSERT_NEAR_ULP_MSG(a, b, ulps, msg, ...)                                                                \
+     CTEST__ASSERT_NEAR(a, b, ctest__make_tolerance(CTEST__TOLERANCE_ULP, ulps),                                        \
+                        #a " == " #b " within " #ulps " ULPs", #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that two float or double arrays of the given number of elements are equal within an absolute
+  *          tolerance. The arrays are checked by vectorized loops, a failure reports the number of values out of
+  *          tolerance, the first one and the one with the largest error.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR(a, b, count, tolerance)                                                                \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_ABS, tolerance),                      \
+                              "|" #a "[i] - " #b "[i]| <= " #tolerance " for i < " #count, #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that two arrays are equal within an absolute tolerance with a custom message.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR_MSG(a, b, count, tolerance, msg, ...)                                                  \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_ABS, tolerance),                      \
+                              "|" #a "[i] - " #b "[i]| <= " #tolerance " for i < " #count, #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that two float or double arrays are equal within a relative tolerance.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR_REL(a, b, count, tolerance)                                                            \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_REL, tolerance),                      \
+                              "|" #a "[i] - " #b "[i]| <= " #tolerance " * max(|" #a "[i]|, |" #b "[i]|) for i < "      \
+                              #count,                                                                                   \
+                              #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that two arrays are equal within a relative tolerance with a custom message.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR_REL_MSG(a, b, count, tolerance, msg, ...)                                              \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_REL, tolerance),                      \
+                              "|" #a "[i] - " #b "[i]| <= " #tolerance " * max(|" #a "[i]|, |" #b "[i]|) for i < "      \
+                              #count,                                                                                   \
+                              #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Asserts that the elements of two float or double arrays are at most the given ULPs apart.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR_ULP(a, b, count, ulps)                                                                 \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_ULP, ulps),                           \
+                              #a "[i] == " #b "[i] within " #ulps " ULPs for i < " #count, #a, #b, "")
+ 
+ /**
+  * @brief   Asserts that the elements of two arrays are at most the given ULPs apart with a custom message.
+  */
+ #define CTEST_ASSERT_ARRAY_NEAR_ULP_MSG(a, b, count, ulps, msg, ...)                                                   \
+     CTEST__ASSERT_ARRAY_NEAR(a, b, count, ctest__make_tolerance(CTEST__TOLERANCE_ULP, ulps),                           \
+                              #a "[i] == " #b "[i] within " #ulps " ULPs for i < " #count, #a, #b, msg, ##__VA_ARGS__)
+ 
+ /**
+  * @brief   Floating point type the operands of a tolerance assertion are compared in, float when both operands are
+  *          float and double otherwise.
+  */
+ #ifdef __cplusplus
+ #define CTEST__REAL_TYPE(a, b) decltype(ctest__real_type((a) + (b)))
+ #else
+ #define CTEST__REAL_TYPE(a, b) __typeof__(_Generic((a) + (b), float: 0.0f, default: 0.0))
+ #endif // __cplusplus
+ 
+ /**
+  * @brief   Picks the float or double implementation of a tolerance check from the type of the values.
+  */
+ #ifdef __cplusplus
+ #define CTEST__NEAR(a, b, tolerance)                 ctest__near(a, b, tolerance)
+ #define CTEST__FIND_NOT_NEAR(a, b, count, tolerance) ctest__find_not_near(a, b, count, tolerance)
+ #else
+ #define CTEST__NEAR(a, b, tolerance)                                                                                   \
+     _Generic((a) + (b), float: ctest__near_float, default: ctest__near_double)(a, b, tolerance)
+ #define CTEST__FIND_NOT_NEAR(a, b, count, tolerance)                                                                   \
+     _Generic(*(a) + *(b), float: ctest__find_not_near_float, default: ctest__find_not_near_double)(a, b, count,        \
+                                                                                                    tolerance)
+ #endif // __cplusplus
+ 
+ /**
+  * @brief   Implements the scalar tolerance assertions, the check of the operands is inlined.
+  */
+ #define CTEST__ASSERT_NEAR(a, b, tolerance, text, a_text, b_text, msg, ...)                                            \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const CTEST__REAL_TYPE(a, b) ctest__left = (a);                                                                \
+         const CTEST__REAL_TYPE(a, b) ctest__right = (b);                                                               \
+         const ctest__tolerance_t ctest__tolerance = tolerance;                                                         \
+         if (CTEST__UNLIKELY(!CTEST__NEAR(ctest__left, ctest__right, ctest__tolerance)))                                \
+         {                                                                                                              \
+             ctest__fail_near(text, a_text, b_text, ctest__left, ctest__right, sizeof(ctest__left) == sizeof(float),    \
+                              ctest__tolerance, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__);                  \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
+ 
+ /**
+  * @brief   Implements the array tolerance assertions.
+  */
+ #define CTEST__ASSERT_ARRAY_NEAR(a, b, count, tolerance, text, a_text, b_text, msg, ...)                               \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const CTEST__TYPEOF(&(a)[0]) ctest__left = (a);                                                                \
+         const CTEST__TYPEOF(&(b)[0]) ctest__right = (b);                                                               \
+         const size_t ctest__count = (count);                                                                           \
+         const ctest__tolerance_t ctest__tolerance = tolerance;                                                         \
+         const size_t ctest__index = CTEST__FIND_NOT_NEAR(ctest__left, ctest__right, ctest__count, ctest__tolerance);   \
+         if (CTEST__UNLIKELY(ctest__index != ctest__count))                                                             \
+         {                                                                                                              \
+             ctest__fail_near_array(text, a_text, b_text, ctest__left, ctest__right,                                    \
+                                    sizeof(*ctest__left) == sizeof(float), ctest__count, ctest__index,                  \
+                                    ctest__tolerance, __FILE__, __FUNCTION__, __LINE__, msg, ##__VA_ARGS__);            \
+             failed_assertions++;                                                                                       \
+         }                                                                                                              \
+     } while (0)
+ 
+ /**
+  * @brief   Fails when the given block allocates from the heap. Allocations are counted when ctest is built with
+  *          CTEST_WRAP_MALLOC, or on ESP-IDF with CONFIG_HEAP_USE_HOOKS, otherwise the assertion fails as it cannot
+  *          check anything. Only allocations of the calling thread are counted.
+  */
+ #define CTEST_ASSERT_NO_ALLOC(...) CTEST__ASSERT_MAX_ALLOCS(0, "no allocations", __VA_ARGS__)
  
  /**
-  * @brief   Defines a test function with a given name and body.
+  * @brief   Fails when the given block makes more than the given number of heap allocations, see CTEST_ASSERT_NO_ALLOC.
   */
- #define CTEST_TEST(name, ...)                                                                                          \
+ #define CTEST_ASSERT_MAX_ALLOCS(max, ...) CTEST__ASSERT_MAX_ALLOCS(max, "at most " #max " allocations", __VA_ARGS__)
+ 
+ /**
+  * @brief   Implements the allocation assertions, the counter is read before and after the block.
+  */
+ #define CTEST__ASSERT_MAX_ALLOCS(max, text, ...)                                                                       \
+     do                                                                                                                 \
+     {                                                                                                                  \
+         const uint64_t ctest__allocs = ctest__count_allocs();                                                          \
+         __VA_ARGS__                                                                                                    \
+         if (CTEST__UNLIKELY(!ctest__check_allocs(ctest__allocs, (max), text, __FILE__, __FUNCTION__, __LINE__, "")))   \
+             failed_assertions++;                                                                                       \
+     } while (0)
+ 
+ /**
+  * @brief   Places the descriptor of a test into the tests linker section, which registers it with the runner.
+  *          Descriptors are aligned to their natural alignment so the section forms an array of them.
+  */
+ #define CTEST__REGISTER(name, timeout_ms, fixture, inputs)                                                             \
+     static int test_##name(void);                                                                                      \
+     __attribute__((used, section(CTEST__SECTION), aligned(__alignof__(ctest__test_t)))) static const ctest__test_t     \
+         ctest__test_##name = {#name, test_##name, __FILE__, __LINE__, timeout_ms, fixture, inputs};
+ 
+ /**
+  * @brief   Defines a test function with a given name and body, the test registers itself with the runner.
+  */
+ #define CTEST_TEST(name, ...) CTEST__TEST(name, 0, NULL, __VA_ARGS__)
+ 
+ /**
+  * @brief   Defines a test that fails when it runs longer than the given number of milliseconds, overriding the
+  *          default timeout of the run. A test that times out is abandoned where it is and the run continues, unless
+  *          it stays stuck on a lock it held, the run then ends after reporting it.
+  */
+ #define CTEST_TEST_TIMEOUT(name, timeout_ms, ...) CTEST__TEST(name, timeout_ms, NULL, __VA_ARGS__)
+ 
+ /**
+  * @brief   Defines a test reading the given comma separated input files, relative to the working directory. With
+  *          '--cache DIR' their content is part of the key of the cached result, so the test runs again when one of
+  *          them changes.
+  */
+ #define CTEST_TEST_INPUTS(name, inputs, ...) CTEST__TEST(name, 0, inputs, __VA_ARGS__)
+ 
+ /**
+  * @brief   Implements CTEST_TEST, CTEST_TEST_TIMEOUT and CTEST_TEST_INPUTS.
+  */
+ #define CTEST__TEST(name, timeout_ms, inputs, ...)                                                                     \
+     CTEST__REGISTER(name, timeout_ms, NULL, inputs)                                                                    \
      static int test_##name(void)                                                                                       \
      {                                                                                                                  \
          int failed_assertions = 0;                                                                                     \
@@ -80,14 +465,156 @@
      }
  
  /**
-  * @brief   Runs all defined tests and returns the result.
+  * @brief   Defines a fixture of the given type, each test using it gets its own instance. The instance is zeroed, set up
+  *          by the CTEST_SETUP body before the test and released by the CTEST_TEARDOWN body after it, both have to be
+  *          defined in the same file. Teardown also runs when the setup fails, the test then fails without running, and
+  *          right after a test that returned early or timed out.
+  */
+ #define CTEST_FIXTURE(name, type) CTEST__FIXTURE(name, type, false)
+ 
+ /**
+  * @brief   Defines a fixture of the given type shared by all tests using it. It is set up lazily by the first test that
+  *          needs it, while parallel tests wait for it, and torn down after the last test of the run using it. Tests must
+  *          treat it as read only. A failed setup is not retried, every test using the fixture fails.
+  */
+ #define CTEST_SUITE_FIXTURE(name, type) CTEST__FIXTURE(name, type, true)
+ 
+ /**
+  * @brief   Declares a fixture defined in another file, so the tests of this file can use it.
+  */
+ #define CTEST_EXTERN_FIXTURE(name, type)                                                                               \
+     typedef type ctest__fixture_type_##name;                                                                           \
+     extern ctest__fixture_t ctest__fixture_##name
+ 
+ /**
+  * @brief   Implements CTEST_FIXTURE and CTEST_SUITE_FIXTURE.
+  */
+ #define CTEST__FIXTURE(name, type, shared)                                                                             \
+     typedef type ctest__fixture_type_##name;                                                                           \
+     static int ctest__setup_##name(type *name);                                                                        \
+     static int ctest__teardown_##name(type *name);                                                                     \
+     static int ctest__setup_fixture_##name(void *data)                                                                 \
+     {                                                                                                                  \
+         return ctest__setup_##name((type *)data);                                                                      \
+     }                                                                                                                  \
+     static int ctest__teardown_fixture_##name(void *data)                                                              \
+     {                                                                                                                  \
+         return ctest__teardown_##name((type *)data);                                                                   \
+     }                                                                                                                  \
+     ctest__fixture_t ctest__fixture_##name = {#name, sizeof(type), shared, ctest__setup_fixture_##name,                \
+                                               ctest__teardown_fixture_##name, NULL, 0, 0}
+ 
+ /**
+  * @brief   Defines the setup of a fixture, the body gets a pointer to the instance named after the fixture. Failed
+  *          assertions fail the setup.
+  */
+ #define CTEST_SETUP(name, ...)                                                                                         \
+     static int ctest__setup_##name(ctest__fixture_type_##name *name)                                                   \
+     {                                                                                                                  \
+         int failed_assertions = 0;                                                                                     \
+         (void)name;                                                                                                    \
+         __VA_ARGS__ return failed_assertions;                                                                          \
+     }
+ 
+ /**
+  * @brief   Defines the teardown of a fixture, the body gets a pointer to the instance named after the fixture.
+  */
+ #define CTEST_TEARDOWN(name, ...)                                                                                      \
+     static int ctest__teardown_##name(ctest__fixture_type_##name *name)                                                \
+     {                                                                                                                  \
+         int failed_assertions = 0;                                                                                     \
+         (void)name;                                                                                                    \
+         __VA_ARGS__ return failed_assertions;                                                                          \
+     }
+ 
+ /**
+  * @brief   Defines a test using a fixture, the body gets a pointer to the instance named after the fixture. A body that
+  *          returns early skips the release, the runner then tears the instance down after the test.
+  */
+ #define CTEST_TEST_FIXTURE(name, fixture, ...)                                                                         \
+     CTEST__REGISTER(name, 0, &ctest__fixture_##fixture, NULL)                                                          \
+     static int test_##name(void)                                                                                       \
+     {                                                                                                                  \
+         int failed_assertions = 0;                                                                                     \
+         ctest__fixture_type_##fixture *fixture = (ctest__fixture_type_##fixture *)ctest__acquire_fixture(              \
+             &ctest__fixture_##fixture, __FILE__, __FUNCTION__, __LINE__, &failed_assertions);                          \
+         if (fixture == NULL)                                                                                           \
+             return failed_assertions;                                                                                  \
+         __VA_ARGS__ failed_assertions += ctest__release_fixture(&ctest__fixture_##fixture, fixture);                   \
+         return failed_assertions;                                                                                      \
+     }
+ 
+ /**
+  * @brief   Defines a benchmark with a given name and body, registered with the runner like a test. The body is run in
+  *          a loop whose iteration count is calibrated to fill the measurement time of a repetition, then the loop is
+  *          measured repeatedly to report the time per operation. Assertions are allowed in the body.
+  */
+ #define CTEST_BENCH(name, ...)                                                                                         \
+     static int ctest__bench_##name(uint64_t ctest__iterations)                                                         \
+     {                                                                                                                  \
+         int failed_assertions = 0;                                                                                     \
+         for (uint64_t ctest__iteration = 0; ctest__iteration < ctest__iterations; ctest__iteration++)                  \
+         {                                                                                                              \
+             __VA_ARGS__                                                                                                \
+         }                                                                                                              \
+         return failed_assertions;                                                                                      \
+     }                                                                                                                  \
+     CTEST__REGISTER(name, 0, NULL, NULL)                                                                               \
+     static int test_##name(void)                                                                                       \
+     {                                                                                                                  \
+         return ctest__run_bench(#name, ctest__bench_##name);                                                           \
+     }
+ 
+ /**
+  * @brief   Keeps the compiler from optimizing away a value computed in a benchmark body.
+  */
+ #define CTEST_DO_NOT_OPTIMIZE(value) __asm__ volatile("" : : "g"(value) : "memory")
+ 
+ /**
+  * @brief   Records the rest of the enclosing block as a span with the given name in the trace of the run written with
+  *          '--trace'. The name must outlive the block. Without a trace the span costs a single check.
+  */
+ #define CTEST_TRACE_SCOPE(name) CTEST__TRACE_SCOPE(name, __COUNTER__)
+ 
+ /**
+  * @brief   Implements CTEST_TRACE_SCOPE, the counter expands first so every span of a block gets its own variable.
+  */
+ #define CTEST__TRACE_SCOPE(name, id) CTEST__TRACE_SCOPE_AT(name, id)
+ #define CTEST__TRACE_SCOPE_AT(name, id)                                                                                \
+     ctest__trace_scope_t ctest__trace_scope_##id __attribute__((cleanup(ctest__end_trace_scope))) =                    \
+         ctest__begin_trace_scope(name)
+ 
+ /**
+  * @brief   Runs all defined tests and returns the result. The generated main accepts '-j N' to run the tests on N
+  *          parallel workers ('-j' or '-j 0' uses all online CPUs) and '--isolate' to run them in a pool of pre-forked
+  *          worker processes, so a crashing test is reported as failed instead of ending the run. '--slowest N' sets the
+  *          number of tests listed in the slowest tests summary (0 disables it). '--bench-time MS' and '--bench-reps N'
+  *          set the measurement time and repetitions of benchmarks. '--bench-save FILE' writes the benchmark samples to
+  *          a baseline file and '--bench-baseline FILE' compares them against one, failing the run when a benchmark is
+  *          slower than '--bench-tolerance PCT' with significance '--bench-alpha P'. '--filter PATTERNS' selects the
+  *          tests to run by comma separated name globs, a leading '-' excludes the tests a glob matches, and '--list'
+  *          prints the names of the selected tests without running them. '--reporter junit|jsonl|tap' streams a machine
+  *          readable report to stdout or to '--report-file FILE'. '--timeout MS' fails the tests running longer than MS
+  *          milliseconds and prints their backtrace. '--durations FILE' records the test durations and starts the
+  *          longest tests first, '--shard-index N' and '--total-shards N' run one shard of the tests. '--leaks
+  *          report|fail' lists the heap allocations a test did not free, failing the test with 'fail'. '--perf'
+  *          collects the hardware performance counters of tests and benchmarks. '--trace FILE' writes a timeline of the
+  *          run in the Chrome trace event format. '--cache DIR' skips the tests that passed before with the same binary,
+  *          or the same '--cache-deps FILES', and the same input files. The CTEST_JOBS, CTEST_ISOLATE, CTEST_SLOWEST,
+  *          CTEST_FILTER, CTEST_REPORTER, CTEST_REPORT_FILE, CTEST_TIMEOUT, CTEST_LEAKS, CTEST_PERF, CTEST_TRACE,
+  *          CTEST_CACHE, CTEST_CACHE_DEPS, CTEST_DURATIONS, CTEST_SHARD_INDEX, CTEST_TOTAL_SHARDS and CTEST_BENCH_*
+  *          environment variables set the defaults.
   */
  #define CTEST_RUN_TESTS()                                                                                              \
-     int main(void)                                                                                                     \
+     int main(int argc, char **argv)                                                                                    \
      {                                                                                                                  \
-         return ctest__run_tests() ? 0 : 1;                                                                             \
+         return ctest__run_tests(argc, argv) ? 0 : 1;                                                                   \
      }
  
+ /**
+  * @brief   Tests register themselves, a TESTS list of ADD(name) entries is still accepted for backward compatibility
+  *          but no longer required.
+  */
  #define ADD(name) static int test_##name(void);
  
  #ifdef TESTS
@@ -95,96 +622,486 @@
  #endif /* TESTS */
  #undef ADD
  
+ #ifdef __cplusplus
+ extern "C" {
+ #endif // __cplusplus
+ 
+ // --- Public Types ----------------------------------------------------------------------------------------------------
+ 
+ /**
+  * @brief   Function generated by CTEST_TEST, returns the number of failed assertions.
+  */
+ typedef int (*ctest__test_fn_t)(void);
+ 
+ /**
+  * @brief   Loop generated by CTEST_BENCH, runs the benchmark body the given number of times and returns the number of
+  *          failed assertions.
+  */
+ typedef int (*ctest__bench_fn_t)(uint64_t iterations);
+ 
+ /**
+  * @brief   Setup or teardown generated by CTEST_SETUP and CTEST_TEARDOWN, returns the number of failed assertions.
+  */
+ typedef int (*ctest__fixture_fn_t)(void *data);
+ 
+ /**
+  * @brief   Descriptor of a fixture defined by CTEST_FIXTURE or CTEST_SUITE_FIXTURE.
+  */
+ typedef struct
+ {
+     const char *name;             // Name of the fixture
+     size_t size;                  // Size of an instance
+     bool shared;                  // One instance is shared by all tests using the fixture
+     ctest__fixture_fn_t setup;    // Sets up a zeroed instance
+     ctest__fixture_fn_t teardown; // Releases an instance
+     void *data;                   // Shared instance, NULL while it is not set up
+     int users;                    // Tests of the run yet to release the shared instance
+     int state;                    // Setup state of the shared instance, owned by the runner
+ } ctest__fixture_t;
+ 
+ /**
+  * @brief   Descriptor of a test, placed into the tests linker section by CTEST_TEST.
+  */
+ typedef struct
+ {
+     const char *name;          // Name of the test
+     ctest__test_fn_t fn;       // Function implementing the test
+     const char *file;          // Source file defining the test
+     int line;                  // Line of the test definition
+     int timeout_ms;            // Timeout of the test in milliseconds, 0 for the default of the run
+     ctest__fixture_t *fixture; // Fixture used by the test, NULL for none
+     const char *inputs;        // Comma separated files the test reads, NULL for none
+ } ctest__test_t;
+ 
+ /**
+  * @brief   Operators of the comparison assertions.
+  */
+ typedef enum
+ {
+     CTEST__EQ,
+     CTEST__NE,
+     CTEST__LT,
+     CTEST__LE,
+     CTEST__GT,
+     CTEST__GE,
+ } ctest__compare_op_t;
+ 
+ /**
+  * @brief   Kinds of values compared by the comparison assertions.
+  */
+ typedef enum
+ {
+     CTEST__VALUE_SIGNED,
+     CTEST__VALUE_UNSIGNED,
+     CTEST__VALUE_DOUBLE,
+     CTEST__VALUE_POINTER,
+ } ctest__value_kind_t;
+ 
+ /**
+  * @brief   Operand of a comparison assertion.
+  */
+ typedef struct
+ {
+     ctest__value_kind_t kind; // Member of the union holding the value
+     union
+     {
+         intmax_t s;    // Signed integer
+         uintmax_t u;   // Unsigned integer or bool
+         double d;      // Floating point value
+         const void *p; // Pointer
+     } as;
+ } ctest__value_t;
+ 
+ /**
+  * @brief   How the tolerance assertions measure the difference of two floating point values.
+  */
+ typedef enum
+ {
+     CTEST__TOLERANCE_ABS, // |a - b| <= value
+     CTEST__TOLERANCE_REL, // |a - b| <= value * max(|a|, |b|)
+     CTEST__TOLERANCE_ULP, // At most ulps representable values apart
+ } ctest__tolerance_kind_t;
+ 
+ /**
+  * @brief   Tolerance of a floating point assertion.
+  */
+ typedef struct
+ {
+     ctest__tolerance_kind_t kind; // How the difference is measured
+     double value;                 // Largest absolute or relative difference
+     uint64_t ulps;                // Largest distance in units in the last place
+ } ctest__tolerance_t;
+ 
+ /**
+  * @brief   Span opened by CTEST_TRACE_SCOPE.
+  */
+ typedef struct
+ {
+     const char *name;  // Name of the span
+     uint64_t start_ns; // Time the span started, 0 when no trace is written
+ } ctest__trace_scope_t;
+ 
  // --- Public Functions Prototypes -------------------------------------------------------------------------------------
  
- static bool ctest__assert(bool result, const char *expression, const char *file, const char *test_name, const int line,
-                           const char *msg, ...);
- static bool ctest__run_tests(void);
- static char *ctest__get_timestamp(void);
+ bool ctest__assert(bool result, const char *expression, const char *file, const char *test_name, const int line,
+                    const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail(const char *expression, const char *file, const char *test_name,
+                                                  int line, const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail_compare(const char *expression, const char *left_text,
+                                                          const char *right_text, ctest__value_t left,
+                                                          ctest__value_t right, const char *file,
+                                                          const char *test_name, int line, const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail_str(const char *expression, const char *left_text,
+                                                      const char *right_text, const char *left, const char *right,
+                                                      const char *file, const char *test_name, int line,
+                                                      const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail_mem(const char *expression, const char *left_text,
+                                                      const char *right_text, const void *left, const void *right,
+                                                      size_t size, size_t offset, const char *file,
+                                                      const char *test_name, int line, const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail_near(const char *expression, const char *left_text,
+                                                       const char *right_text, double left, double right, bool single,
+                                                       ctest__tolerance_t tolerance, const char *file,
+                                                       const char *test_name, int line, const char *msg, ...);
+ __attribute__((cold, noinline)) void ctest__fail_near_array(const char *expression, const char *left_text,
+                                                             const char *right_text, const void *left,
+                                                             const void *right, bool single, size_t count,
+                                                             size_t first, ctest__tolerance_t tolerance,
+                                                             const char *file, const char *test_name, int line,
+                                                             const char *msg, ...);
+ size_t ctest__find_mismatch(const void *a, const void *b, size_t size);
+ size_t ctest__find_not_near_float(const float *a, const float *b, size_t count, ctest__tolerance_t tolerance);
+ size_t ctest__find_not_near_double(const double *a, const double *b, size_t count, ctest__tolerance_t tolerance);
+ bool ctest__run_tests(int argc, char **argv);
+ int ctest__run_bench(const char *name, ctest__bench_fn_t fn);
+ void *ctest__acquire_fixture(ctest__fixture_t *fixture, const char *file, const char *test_name, int line,
+                              int *failed_assertions);
+ int ctest__release_fixture(ctest__fixture_t *fixture, void *data);
+ uint64_t ctest__count_allocs(void);
+ bool ctest__check_allocs(uint64_t start, uint64_t max, const char *expression, const char *file, const char *test_name,
+                          int line, const char *msg, ...);
+ ctest__trace_scope_t ctest__begin_trace_scope(const char *name);
+ void ctest__end_trace_scope(ctest__trace_scope_t *scope);
+ 
+ /**
+  * @brief   Allocates memory from the arena of the running test, aligned like malloc. The memory must not be freed, the
+  *          whole arena is reset in constant time before the next test on the same worker, so it must not outlive the
+  *          test or back a suite fixture. Returns NULL when out of memory.
+  */
+ __attribute__((malloc, alloc_size(1))) void *ctest_alloc(size_t size);
  
  // --- Public Functions Definitions ------------------------------------------------------------------------------------
  
- static bool ctest__assert(bool result, const char *expression, const char *file, const char *test_name, const int line,
-                           const char *msg, ...)
+ /**
+  * @brief   Constructors of the operands of comparison assertions, inlined so a passing comparison stays a single
+  *          compare and branch.
+  */
+ static inline ctest__value_t ctest__value_signed(intmax_t value)
+ {
+     ctest__value_t result;
+     result.kind = CTEST__VALUE_SIGNED;
+     result.as.s = value;
+     return result;
+ }
+ 
+ static inline ctest__value_t ctest__value_unsigned(uintmax_t value)
+ {
+     ctest__value_t result;
+     result.kind = CTEST__VALUE_UNSIGNED;
+     result.as.u = value;
+     return result;
+ }
+ 
+ static inline ctest__value_t ctest__value_double(double value)
+ {
+     ctest__value_t result;
+     result.kind = CTEST__VALUE_DOUBLE;
+     result.as.d = value;
+     return result;
+ }
+ 
+ static inline ctest__value_t ctest__value_pointer(const void *value)
+ {
+     ctest__value_t result;
+     result.kind = CTEST__VALUE_POINTER;
+     result.as.p = value;
+     return result;
+ }
+ 
+ /**
+  * @brief   Compares two operands, the kinds are known at compile time so all but one branch is folded away.
+  */
+ static inline bool ctest__compare(ctest__value_t left, ctest__value_t right, ctest__compare_op_t op)
  {
-     if (result)
+     int order; // -1, 0 or 1, 2 when unordered
+     if (left.kind == CTEST__VALUE_DOUBLE || right.kind == CTEST__VALUE_DOUBLE)
      {
-         return true;
+         double x = left.kind == CTEST__VALUE_DOUBLE ? left.as.d
+                    : left.kind == CTEST__VALUE_SIGNED ? (double)left.as.s
+                                                       : (double)left.as.u;
+         double y = right.kind == CTEST__VALUE_DOUBLE ? right.as.d
+                    : right.kind == CTEST__VALUE_SIGNED ? (double)right.as.s
+                                                        : (double)right.as.u;
+         order = x < y ? -1 : (x > y ? 1 : (x == y ? 0 : 2));
+     }
+     else if (left.kind == CTEST__VALUE_POINTER || right.kind == CTEST__VALUE_POINTER)
+     {
+         uintptr_t x = left.kind == CTEST__VALUE_POINTER ? (uintptr_t)left.as.p : (uintptr_t)left.as.u;
+         uintptr_t y = right.kind == CTEST__VALUE_POINTER ? (uintptr_t)right.as.p : (uintptr_t)right.as.u;
+         order = (x > y) - (x < y);
+     }
+     else if (left.kind == CTEST__VALUE_SIGNED && right.kind == CTEST__VALUE_SIGNED)
+     {
+         order = (left.as.s > right.as.s) - (left.as.s < right.as.s);
+     }
+     else if (left.kind == CTEST__VALUE_SIGNED && left.as.s < 0)
+     {
+         order = -1; // Negative is less than any unsigned value
+     }
+     else if (right.kind == CTEST__VALUE_SIGNED && right.as.s < 0)
+     {
+         order = 1;
      }
      else
      {
-         fprintf(stderr, "❌ %s:%d -> %s\n💬 Assertion of '%s' failed\n📝 ", file, line, test_name, expression);
-         va_list args;
-         va_start(args, msg);
-         vfprintf(stderr, msg, args);
-         fprintf(stderr, "\n");
-         return false;
+         order = (left.as.u > right.as.u) - (left.as.u < right.as.u);
      }
+ 
+     switch (op)
+     {
+     case CTEST__EQ:
+         return order == 0;
+     case CTEST__NE:
+         return order != 0;
+     case CTEST__LT:
+         return order == -1;
+     case CTEST__LE:
+         return order == -1 || order == 0;
+     case CTEST__GT:
+         return order == 1;
+     case CTEST__GE:
+         return order == 1 || order == 0;
+     }
+     return false;
  }
  
- static bool ctest__run_tests(void)
+ /**
+  * @brief   Compares two strings, NULL is only equal to NULL.
+  */
+ static inline bool ctest__equal_str(const char *left, const char *right)
  {
- #ifndef TESTS
- #define TESTS // Defined to omit useless warnings when compiling
-     fprintf(stderr, "ERROR: No tests are defined!\n");
-     exit(1);
- #endif // !TESTS
+     if (left == NULL || right == NULL)
+         return left == right;
+     return strcmp(left, right) == 0;
+ }
  
-     int test_count = 0;
- #define ADD(name) test_count++;
-     TESTS
- #undef ADD
-     printf(CTEST_GRY "INFO: Running a total of %d tests.\n\n", test_count);
- 
-     int fail_test_count = 0;
-     int failed_assertions = 0;
-     time_t start_time = time(NULL);
-     // #define ADD(name) fail_test_count += test_##name() ? 1 : 0;
- #define ADD(name)                                                                                                      \
-     failed_assertions = test_##name();                                                                                 \
-     if (failed_assertions > 0)                                                                                         \
-     {                                                                                                                  \
-         fprintf(stderr, "💥 Test " CTEST_GRYB "%s" CTEST_GRY " failed %d assertions!\n", #name, failed_assertions);    \
-         fail_test_count++;                                                                                             \
-     }                                                                                                                  \
-     else                                                                                                               \
-     {                                                                                                                  \
-         fprintf(stderr, "✅ Test " CTEST_GRYB "%s" CTEST_GRY " passed.\n", #name);                                     \
-     }
-     TESTS
- #undef ADD
-     time_t end_time = time(NULL);
- 
-     printf("\n");
-     int pass_test_count = test_count - fail_test_count;
-     printf(CTEST_GRY "    Tests  " CTEST_RED "%d failed" CTEST_GRY " | " CTEST_GRN "%d passed" CTEST_GRY
-                      " (%d)\n" CTEST_RST,
-            fail_test_count, pass_test_count, test_count);
-     printf(CTEST_GRY " Start at  " CTEST_RST "%s\n", ctest__get_timestamp());
-     printf(CTEST_GRY " Duration  " CTEST_RST "%lds\n", end_time - start_time);
-     if (fail_test_count > 0)
+ /**
+  * @brief   Constructs the tolerance of a floating point assertion. A NaN is UINT64_MAX ULPs from any value, the limit
+  *          of ULPs stays below it.
+  */
+ static inline ctest__tolerance_t ctest__make_tolerance(ctest__tolerance_kind_t kind, double value)
+ {
+     ctest__tolerance_t result;
+     result.kind = kind;
+     result.value = value;
+     result.ulps = value > 0 ? (value < 18446744073709551616.0 ? (uint64_t)value : UINT64_MAX - 1) : 0;
+     return result;
+ }
+ 
+ /**
+  * @brief   Number of representable values between two floating point values, UINT64_MAX when either is NaN. The
+  *          bit patterns are mapped to integers ordered like the values, so adjacent values differ by one.
+  */
+ static inline uint64_t ctest__ulps_float(float a, float b)
+ {
+     if (a != a || b != b)
+         return UINT64_MAX;
+     int32_t x;
+     int32_t y;
+     memcpy(&x, &a, sizeof(x));
+     memcpy(&y, &b, sizeof(y));
+     x = x < 0 ? INT32_MIN - x : x;
+     y = y < 0 ? INT32_MIN - y : y;
+     return x > y ? (uint64_t)((int64_t)x - y) : (uint64_t)((int64_t)y - x);
+ }
+ 
+ static inline uint64_t ctest__ulps_double(double a, double b)
+ {
+     if (a != a || b != b)
+         return UINT64_MAX;
+     int64_t x;
+     int64_t y;
+     memcpy(&x, &a, sizeof(x));
+     memcpy(&y, &b, sizeof(y));
+     x = x < 0 ? INT64_MIN - x : x;
+     y = y < 0 ? INT64_MIN - y : y;
+     return x > y ? (uint64_t)x - (uint64_t)y : (uint64_t)y - (uint64_t)x;
+ }
+ 
+ /**
+  * @brief   Checks two floating point values against a tolerance. Equal values always pass and NaN never does, an
+  *          infinity is only near an equal infinity, so an overflow does not pass a relative bound.
+  */
+ static inline bool ctest__near_float(float a, float b, ctest__tolerance_t tolerance)
+ {
+     if (a == b)
+         return true;
+     if (!__builtin_isfinite(a) || !__builtin_isfinite(b))
          return false;
-     return true;
+     if (tolerance.kind == CTEST__TOLERANCE_ULP)
+         return ctest__ulps_float(a, b) <= tolerance.ulps;
+     float difference = a > b ? a - b : b - a;
+     if (tolerance.kind == CTEST__TOLERANCE_ABS)
+         return difference <= (float)tolerance.value;
+     float magnitude_a = a < 0 ? -a : a;
+     float magnitude_b = b < 0 ? -b : b;
+     return difference <= (float)tolerance.value * (magnitude_a > magnitude_b ? magnitude_a : magnitude_b);
  }
  
- static char *ctest__get_timestamp(void)
+ static inline bool ctest__near_double(double a, double b, ctest__tolerance_t tolerance)
  {
-     time_t rawtime;
-     struct tm *timeinfo;
+     if (a == b)
+         return true;
+     if (!__builtin_isfinite(a) || !__builtin_isfinite(b))
+         return false;
+     if (tolerance.kind == CTEST__TOLERANCE_ULP)
+         return ctest__ulps_double(a, b) <= tolerance.ulps;
+     double difference = a > b ? a - b : b - a;
+     if (tolerance.kind == CTEST__TOLERANCE_ABS)
+         return difference <= tolerance.value;
+     double magnitude_a = a < 0 ? -a : a;
+     double magnitude_b = b < 0 ? -b : b;
+     return difference <= tolerance.value * (magnitude_a > magnitude_b ? magnitude_a : magnitude_b);
+ }
  
-     char *buffer = (char *)malloc(9 * sizeof(char)); // HH:MM:SS + null terminator
-     if (buffer == NULL)
-     {
-         fprintf(stderr, "ERROR: Could not allocate memory for timestamp!\n");
-         exit(1);
-     }
+ #ifdef __cplusplus
+ }
  
-     time(&rawtime);
-     timeinfo = localtime(&rawtime);
-     strftime(buffer, 9, "%H:%M:%S", timeinfo);
+ /**
+  * @brief   Constructors of the operands of comparison assertions in C++, overloads take the place of _Generic.
+  */
+ static inline ctest__value_t ctest__make_value(bool value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(char value)
+ {
+     return ctest__value_signed(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(signed char value)
+ {
+     return ctest__value_signed(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(short value)
+ {
+     return ctest__value_signed(value);
+ }
  
-     return buffer;
+ static inline ctest__value_t ctest__make_value(int value)
+ {
+     return ctest__value_signed(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(long value)
+ {
+     return ctest__value_signed(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(long long value)
+ {
+     return ctest__value_signed(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(unsigned char value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(unsigned short value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(unsigned int value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(unsigned long value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(unsigned long long value)
+ {
+     return ctest__value_unsigned(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(float value)
+ {
+     return ctest__value_double(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(double value)
+ {
+     return ctest__value_double(value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(long double value)
+ {
+     return ctest__value_double((double)value);
+ }
+ 
+ static inline ctest__value_t ctest__make_value(decltype(nullptr))
+ {
+     return ctest__value_pointer(NULL);
+ }
+ 
+ template <typename T> static inline ctest__value_t ctest__make_value(T *value)
+ {
+     return ctest__value_pointer((const void *)value);
+ }
+ 
+ /**
+  * @brief   Type the operands of a tolerance assertion are compared in, only named in unevaluated context.
+  */
+ static inline float ctest__real_type(float value)
+ {
+     return value;
+ }
+ 
+ template <typename T> static inline double ctest__real_type(T value)
+ {
+     return (double)value;
+ }
+ 
+ /**
+  * @brief   Tolerance checks in C++, overloads take the place of _Generic.
+  */
+ static inline bool ctest__near(float a, float b, ctest__tolerance_t tolerance)
+ {
+     return ctest__near_float(a, b, tolerance);
+ }
+ 
+ static inline bool ctest__near(double a, double b, ctest__tolerance_t tolerance)
+ {
+     return ctest__near_double(a, b, tolerance);
+ }
+ 
+ static inline size_t ctest__find_not_near(const float *a, const float *b, size_t count, ctest__tolerance_t tolerance)
+ {
+     return ctest__find_not_near_float(a, b, count, tolerance);
+ }
+ 
+ static inline size_t ctest__find_not_near(const double *a, const double *b, size_t count,
+                                           ctest__tolerance_t tolerance)
+ {
+     return ctest__find_not_near_double(a, b, count, tolerance);
  }
+ #endif // __cplusplus
  
  #endif /* CTEST_H */
  
@@ -1 +1,1288 @@
-// File exists only to link ctest as library 
\ No newline at end of file
+/***********************************************************************************************************************
+ *
+ * @file        ctest.c
+ * @brief       Test runner, assertion reporting and output of CTest.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#endif // ESP_PLATFORM
+
+// Process isolation needs fork, which is not available on ESP-IDF
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(ESP_PLATFORM)
+#define CTEST__HAS_FORK 1
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#else
+#define CTEST__HAS_FORK 0
+#endif // Process isolation
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Boundaries of the tests linker section.
+ */
+#if defined(ESP_PLATFORM)
+#define CTEST__TESTS_BEGIN _ctest_tests_start // Defined by SURROUND in linker.lf
+#define CTEST__TESTS_END   _ctest_tests_end
+#elif defined(__APPLE__)
+#define CTEST__TESTS_BEGIN ctest__tests_begin
+#define CTEST__TESTS_END   ctest__tests_end
+#else
+#define CTEST__TESTS_BEGIN __start_ctest_tests // Defined by the linker for sections named as C identifiers
+#define CTEST__TESTS_END   __stop_ctest_tests
+#endif // Linker section
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+#if CTEST__HAS_FORK
+/**
+ * @brief   Worker process of the isolated runner.
+ */
+typedef struct
+{
+    pid_t pid;           // Process id of the worker, 0 when the slot has no running worker
+    int task_fd;         // Write end of the pipe delivering test indexes to the worker
+    int result_fd;       // Read end of the pipe returning results from the worker
+    int test;            // Index of the test the worker is running, -1 when idle
+    uint64_t started_ns; // Time the test was dispatched to the worker
+    uint64_t timeout_ns; // Time the test may run, 0 for no limit
+    bool timed_out;      // Test ran out of time and the worker was told to stop
+} ctest__process_t;
+
+/**
+ * @brief   Message sent by a worker process after it finished a test.
+ */
+typedef struct
+{
+    int test;                   // Index of the finished test
+    ctest__result_t result;     // Result of the finished test
+    ctest__failures_t failures; // Failures recorded for the report
+} ctest__process_msg_t;
+#endif // CTEST__HAS_FORK
+
+/**
+ * @brief   Operand of a failed comparison, printed below the failed assertion.
+ */
+typedef struct
+{
+    const char *text;  // Source text of the operand
+    const char *value; // Formatted value of the operand
+    bool quoted;       // Value is a string and printed in quotes
+} ctest__operand_t;
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Boundaries of the tests linker section, the registry of all tests linked into the executable. Weak on ELF
+ *          so an executable without tests still links.
+ */
+#if defined(ESP_PLATFORM)
+extern const ctest__test_t CTEST__TESTS_BEGIN[];
+extern const ctest__test_t CTEST__TESTS_END[];
+#elif defined(__APPLE__)
+extern const ctest__test_t CTEST__TESTS_BEGIN[] __asm("section$start$__DATA$ctest_tests");
+extern const ctest__test_t CTEST__TESTS_END[] __asm("section$end$__DATA$ctest_tests");
+#else
+extern const ctest__test_t CTEST__TESTS_BEGIN[] __attribute__((weak));
+extern const ctest__test_t CTEST__TESTS_END[] __attribute__((weak));
+#endif // Linker section
+
+// --- Public Variables ------------------------------------------------------------------------------------------------
+
+ctest__options_t ctest__options;
+__thread ctest__result_t *ctest__current_result;
+__thread ctest__failures_t *ctest__current_failures;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static void ctest__report_failure(const char *expression, const ctest__operand_t *operands, int operand_count,
+                                  const char *file, const char *test_name, int line, const char *msg, va_list args);
+static const char *ctest__format_value(ctest__value_t value, char *buffer, size_t size);
+static void ctest__parse_options(int argc, char **argv, ctest__options_t *options);
+static int ctest__parse_jobs(const char *value);
+static const char *ctest__get_shard_env(const char *name);
+static uint64_t ctest__get_timeout_ns(const ctest__test_t *test);
+static void ctest__run_test(const ctest__test_t *test, ctest__result_t *result, ctest__failures_t *failures);
+static void *ctest__worker(void *arg);
+#if CTEST__HAS_FORK
+static void ctest__run_processes(ctest__run_t *run, int workers);
+static bool ctest__spawn_process(ctest__run_t *run, ctest__process_t *processes, int workers, int slot);
+static void ctest__process_main(ctest__run_t *run, int task_fd, int result_fd);
+static void ctest__finish_process(ctest__run_t *run, ctest__process_t *process);
+static bool ctest__dispatch_process(ctest__run_t *run, ctest__process_t *process);
+static int ctest__check_timeouts(ctest__process_t *processes, int workers);
+static bool ctest__read_all(int fd, void *data, size_t size);
+static bool ctest__write_all(int fd, const void *data, size_t size);
+#endif // CTEST__HAS_FORK
+static void ctest__print_slowest(FILE *console, const ctest__run_t *run, int slowest);
+static void ctest__print_allocs(FILE *console, const ctest__run_t *run);
+static void ctest__print_perf(FILE *console, const ctest__run_t *run);
+static int ctest__compare_test(const void *a, const void *b);
+static const char *ctest__format_timestamp(time_t time, char *buffer, size_t size);
+static ctest__leaks_t ctest__parse_leaks(const char *value);
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+bool ctest__assert(bool result, const char *expression, const char *file, const char *test_name, const int line,
+                   const char *msg, ...)
+{
+    if (result)
+    {
+        return true;
+    }
+    else
+    {
+        va_list args;
+        va_start(args, msg);
+        ctest__report_failure(expression, NULL, 0, file, test_name, line, msg, args);
+        va_end(args);
+        return false;
+    }
+}
+
+void ctest__fail(const char *expression, const char *file, const char *test_name, int line, const char *msg, ...)
+{
+    va_list args;
+    va_start(args, msg);
+    ctest__report_failure(expression, NULL, 0, file, test_name, line, msg, args);
+    va_end(args);
+}
+
+ctest__failure_t *ctest__begin_failure(const char *expression, const char *file, const char *test_name, int line)
+{
+    ctest__failures_t *failures = ctest__current_failures;
+    ctest__failure_t *failure = NULL;
+    if (failures != NULL && failures->count < CTEST_REPORT_FAILURES_MAX)
+    {
+        failure = &failures->items[failures->count++];
+        failure->file = file;
+        failure->line = line;
+        failure->expression = expression;
+        failure->values[0] = '\0';
+    }
+
+    // Collected with the rest of the test output, which is written as a whole once the test finishes
+    ctest__print("❌ %s:%d -> %s\n💬 Assertion of '%s' failed\n", file, line, test_name, expression);
+    return failure;
+}
+
+void ctest__add_failure_value(ctest__failure_t *failure, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    ctest__print("🔎 ");
+    const char *text = ctest__vprint(format, args);
+    // Report lists the values separated by commas, copied before the next print may move the text
+    if (failure != NULL && text != NULL)
+    {
+        size_t length = strlen(failure->values);
+        snprintf(&failure->values[length], sizeof(failure->values) - length, "%s%s", length > 0 ? ", " : "", text);
+    }
+    ctest__print("\n");
+    va_end(args);
+}
+
+void ctest__add_failure_operand(ctest__failure_t *failure, const char *text, const char *value, bool quoted)
+{
+    // A literal operand already shows its value
+    const char *quote = quoted ? "\"" : "";
+    size_t length = strlen(value);
+    const char *literal = text + (quoted && text[0] == '"' ? 1 : 0);
+    if (strncmp(literal, value, length) == 0 && strcmp(&literal[length], quote) == 0)
+        return;
+    ctest__add_failure_value(failure, "%s = %s%s%s", text, quote, value, quote);
+}
+
+void ctest__end_failure(ctest__failure_t *failure, const char *msg, va_list args)
+{
+    // Message is formatted once into the output of the test, the report gets a copy of the formatted text
+    ctest__print("📝 ");
+    const char *message = ctest__vprint(msg, args);
+    if (failure != NULL)
+        snprintf(failure->message, sizeof(failure->message), "%s", message != NULL ? message : "");
+    ctest__print("\n");
+}
+
+void ctest__fail_compare(const char *expression, const char *left_text, const char *right_text, ctest__value_t left,
+                         ctest__value_t right, const char *file, const char *test_name, int line, const char *msg, ...)
+{
+    char left_value[64];
+    char right_value[64];
+    ctest__operand_t operands[2] = {
+        {left_text, ctest__format_value(left, left_value, sizeof(left_value)), false},
+        {right_text, ctest__format_value(right, right_value, sizeof(right_value)), false},
+    };
+    va_list args;
+    va_start(args, msg);
+    ctest__report_failure(expression, operands, 2, file, test_name, line, msg, args);
+    va_end(args);
+}
+
+void ctest__fail_str(const char *expression, const char *left_text, const char *right_text, const char *left,
+                     const char *right, const char *file, const char *test_name, int line, const char *msg, ...)
+{
+    ctest__operand_t operands[2] = {
+        {left_text, left != NULL ? left : "NULL", left != NULL},
+        {right_text, right != NULL ? right : "NULL", right != NULL},
+    };
+    va_list args;
+    va_start(args, msg);
+    ctest__report_failure(expression, operands, 2, file, test_name, line, msg, args);
+    va_end(args);
+}
+
+bool ctest__run_tests(int argc, char **argv)
+{
+    int registered_count = (int)(CTEST__TESTS_END - CTEST__TESTS_BEGIN);
+    if (registered_count <= 0)
+    {
+        fprintf(stderr, "ERROR: No tests are defined!\n");
+        exit(1);
+    }
+    ctest__parse_options(argc, argv, &ctest__options);
+
+    // Filter is compiled once, then the registry is compacted into the array of tests to run
+    ctest__filter_t filter;
+    if (ctest__options.filter != NULL && !ctest__compile_filter(ctest__options.filter, &filter))
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for test filter!\n");
+        exit(1);
+    }
+    ctest__test_t *tests = (ctest__test_t *)malloc(registered_count * sizeof(ctest__test_t));
+    if (tests == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for tests!\n");
+        exit(1);
+    }
+    int test_count = 0;
+    for (const ctest__test_t *test = CTEST__TESTS_BEGIN; test < CTEST__TESTS_END; test++)
+    {
+        if (ctest__options.filter == NULL || ctest__match_filter(&filter, test->name))
+            tests[test_count++] = *test;
+    }
+    if (ctest__options.filter != NULL)
+        ctest__free_filter(&filter);
+
+    // Section order depends on the compiler and linker, run the tests ordered by their definition instead
+    qsort(tests, test_count, sizeof(ctest__test_t), ctest__compare_test);
+
+    // Every shard sees the same tests in the same order, so each one can pick its part without talking to the others
+    int selected_count = test_count;
+    if (ctest__options.shard_count > 1)
+    {
+        test_count = ctest__shard_tests(tests, test_count, ctest__options.shard_index, ctest__options.shard_count,
+                                        ctest__options.durations);
+    }
+    if (ctest__options.shard_count > 0)
+    {
+        // Bazel checks for this file to know the test honored the sharding variables
+        const char *status_file = ctest__get_shard_env("SHARD_STATUS_FILE");
+        FILE *file = status_file != NULL ? fopen(status_file, "w") : NULL;
+        if (file != NULL)
+            fclose(file);
+    }
+
+    if (ctest__options.list)
+    {
+        for (int i = 0; i < test_count; i++)
+            printf("%s\n", tests[i].name);
+        free(tests);
+        return true;
+    }
+
+    // A report written to stdout must not be mixed with the summary, which moves to stderr
+    FILE *console = (ctest__options.reporter != NULL && ctest__options.report_file == NULL) ? stderr : stdout;
+    int workers = ctest__options.jobs < test_count ? ctest__options.jobs : test_count;
+
+    // Longest tests start first, so no long test is left running alone at the end of a parallel run
+    if (ctest__options.durations != NULL && workers > 1)
+        ctest__schedule_tests(tests, test_count, ctest__options.durations);
+    int filtered_count = registered_count - selected_count;
+    if (workers > 1)
+        fprintf(console, CTEST_GRY "INFO: Running a total of %d tests on %d workers", test_count, workers);
+    else
+        fprintf(console, CTEST_GRY "INFO: Running a total of %d tests", test_count);
+    if (filtered_count > 0)
+        fprintf(console, ", %d filtered out", filtered_count);
+    if (ctest__options.shard_count > 1)
+        fprintf(console, ", shard %d of %d", ctest__options.shard_index + 1, ctest__options.shard_count);
+    fprintf(console, ".\n\n");
+    fflush(console);
+
+    ctest__run_t run = {tests, test_count, (ctest__result_t *)calloc(test_count + 1, sizeof(ctest__result_t)), 0};
+    if (run.results == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for test results!\n");
+        exit(1);
+    }
+    for (int i = 0; i < test_count; i++)
+        run.results[i].exit_status = -1;
+
+    // Allocations are recorded from here on, anything allocated before the tests start is not theirs
+    if (ctest__options.leaks != CTEST_LEAKS_OFF)
+    {
+        if (!ctest__is_heap_tracked())
+            fprintf(stderr, "WARNING: Allocations are not tracked, leaks are found with CTEST_WRAP_MALLOC only.\n");
+        ctest__enable_leak_check();
+    }
+    // Counters belong to the thread that opened them, every worker opens its own on first use
+    if (ctest__options.perf)
+    {
+        if (!ctest__open_perf())
+            fprintf(stderr, "WARNING: Performance counters are not available, tests run without them.\n");
+        ctest__close_perf();
+    }
+    if (ctest__options.trace != NULL && !ctest__open_trace(ctest__options.trace))
+    {
+        fprintf(stderr, "ERROR: Could not open trace file '%s'!\n", ctest__options.trace);
+        exit(1);
+    }
+    // Tests that passed before with the same binary and inputs are reported without running
+    int cached_count = 0;
+    if (ctest__options.cache != NULL)
+    {
+        cached_count =
+            ctest__check_cache(ctest__options.cache, ctest__options.cache_deps, tests, test_count, run.results);
+    }
+    ctest__prepare_fixtures(&run);
+    ctest__init_output();
+    ctest__open_report(&run);
+    time_t start_time = time(NULL);
+    uint64_t start_ns = ctest__get_time_ns();
+    if (ctest__options.isolate)
+    {
+#if CTEST__HAS_FORK
+        ctest__run_processes(&run, workers < 1 ? 1 : workers);
+#else
+        fprintf(stderr, "ERROR: Running tests in isolated processes is not supported on this platform!\n");
+        exit(1);
+#endif // CTEST__HAS_FORK
+    }
+    else
+    {
+        pthread_t *threads = (pthread_t *)calloc(workers + 1, sizeof(pthread_t));
+        if (threads == NULL)
+        {
+            fprintf(stderr, "ERROR: Could not allocate memory for workers!\n");
+            exit(1);
+        }
+        // Watchdog only runs when a test has a timeout, without it tests run as plain calls
+        bool timeouts = ctest__options.timeout > 0;
+        for (int i = 0; i < test_count && !timeouts; i++)
+            timeouts = tests[i].timeout_ms > 0;
+        if (timeouts && !ctest__start_watchdog())
+            fprintf(stderr, "WARNING: Test timeouts are not supported, tests run without a time limit!\n");
+
+        // The calling thread is a worker as well, additional workers only speed up the run so failing to start is fine
+        int started = 0;
+        while (started < workers - 1 && pthread_create(&threads[started], NULL, ctest__worker, &run) == 0)
+            started++;
+        ctest__worker(&run);
+        for (int i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+        free(threads);
+        ctest__stop_watchdog();
+    }
+    ctest__teardown_fixtures(tests, test_count);
+    ctest__close_trace();
+    uint64_t duration_ns = ctest__get_time_ns() - start_ns;
+    if (ctest__options.durations != NULL)
+        ctest__save_durations(ctest__options.durations, &run);
+    if (ctest__options.cache != NULL)
+        ctest__save_cache(ctest__options.cache, &run);
+
+    int compared = 0;
+    int regressed = ctest__check_benches(&run, &compared);
+
+    int fail_test_count = 0;
+    for (int i = 0; i < test_count; i++)
+    {
+        const ctest__result_t *result = &run.results[i];
+        fail_test_count += (result->failed_assertions > 0 || result->signal != 0 || result->exit_status >= 0 ||
+                            result->timed_out)
+                               ? 1
+                               : 0;
+    }
+    ctest__close_report(fail_test_count, duration_ns);
+
+    fprintf(console, "\n");
+    int pass_test_count = test_count - fail_test_count - cached_count;
+    fprintf(console, CTEST_GRY "    Tests  " CTEST_RED "%d failed" CTEST_GRY " | " CTEST_GRN "%d passed" CTEST_GRY,
+            fail_test_count, pass_test_count);
+    if (ctest__options.cache != NULL)
+        fprintf(console, " | %d cached", cached_count);
+    fprintf(console, " (%d)\n" CTEST_RST, test_count);
+    char timestamp[16];
+    fprintf(console, CTEST_GRY " Start at  " CTEST_RST "%s\n",
+            ctest__format_timestamp(start_time, timestamp, sizeof(timestamp)));
+    char duration[32];
+    ctest__format_duration((double)duration_ns, duration, sizeof(duration));
+    fprintf(console, CTEST_GRY " Duration  " CTEST_RST "%s\n", duration);
+    ctest__print_slowest(console, &run, ctest__options.slowest);
+    ctest__print_allocs(console, &run);
+    ctest__print_perf(console, &run);
+    if (ctest__options.bench_baseline != NULL)
+    {
+        fprintf(console,
+                CTEST_GRY "  Benches  " CTEST_RED "%d regressed" CTEST_GRY " | " CTEST_GRN "%d compared" CTEST_GRY
+                          " (tolerance %g%%, alpha %g)\n" CTEST_RST,
+                regressed, compared, ctest__options.bench_tolerance, ctest__options.bench_alpha);
+    }
+    free(run.results);
+    free(tests);
+    if (fail_test_count > 0 || regressed > 0)
+        return false;
+    return true;
+}
+
+int ctest__parse_count(const char *value, const char *what)
+{
+    char *end = NULL;
+    long count = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || count < 0 || count > INT32_MAX)
+    {
+        fprintf(stderr, "ERROR: Invalid number of %s '%s'!\n", what, value);
+        exit(1);
+    }
+    return (int)count;
+}
+
+double ctest__parse_double(const char *value, const char *what)
+{
+    char *end = NULL;
+    double number = strtod(value, &end);
+    if (end == value || *end != '\0' || !(number >= 0.0))
+    {
+        fprintf(stderr, "ERROR: Invalid %s '%s'!\n", what, value);
+        exit(1);
+    }
+    return number;
+}
+
+uint64_t ctest__get_time_ns(void)
+{
+#ifdef ESP_PLATFORM
+    return (uint64_t)esp_timer_get_time() * 1000u;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif // ESP_PLATFORM
+}
+
+const char *ctest__format_duration(double ns, char *buffer, size_t size)
+{
+    if (ns < 1e3)
+        snprintf(buffer, size, "%.3g ns", ns);
+    else if (ns < 1e6)
+        snprintf(buffer, size, "%.2f us", ns / 1e3);
+    else if (ns < 1e9)
+        snprintf(buffer, size, "%.2f ms", ns / 1e6);
+    else
+        snprintf(buffer, size, "%.2f s", ns / 1e9);
+    return buffer;
+}
+
+const char *ctest__format_rate(double per_second, char *buffer, size_t size)
+{
+    if (per_second < 1e3)
+        snprintf(buffer, size, "%.3g", per_second);
+    else if (per_second < 1e6)
+        snprintf(buffer, size, "%.2f k", per_second / 1e3);
+    else if (per_second < 1e9)
+        snprintf(buffer, size, "%.2f M", per_second / 1e6);
+    else
+        snprintf(buffer, size, "%.2f G", per_second / 1e9);
+    return buffer;
+}
+
+const char *ctest__format_size(double bytes, char *buffer, size_t size)
+{
+    if (bytes < 1024.0)
+        snprintf(buffer, size, "%.0f B", bytes);
+    else if (bytes < 1024.0 * 1024.0)
+        snprintf(buffer, size, "%.2f KiB", bytes / 1024.0);
+    else if (bytes < 1024.0 * 1024.0 * 1024.0)
+        snprintf(buffer, size, "%.2f MiB", bytes / (1024.0 * 1024.0));
+    else
+        snprintf(buffer, size, "%.2f GiB", bytes / (1024.0 * 1024.0 * 1024.0));
+    return buffer;
+}
+
+int ctest__compare_timing(const void *a, const void *b)
+{
+    const ctest__timing_t *timing_a = (const ctest__timing_t *)a;
+    const ctest__timing_t *timing_b = (const ctest__timing_t *)b;
+    if (timing_a->duration_ns != timing_b->duration_ns)
+        return timing_a->duration_ns < timing_b->duration_ns ? 1 : -1;
+    return timing_a->test - timing_b->test;
+}
+
+int ctest__compare_double(const void *a, const void *b)
+{
+    double value_a = *(const double *)a;
+    double value_b = *(const double *)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static void ctest__report_failure(const char *expression, const ctest__operand_t *operands, int operand_count,
+                                  const char *file, const char *test_name, int line, const char *msg, va_list args)
+{
+    ctest__failure_t *failure = ctest__begin_failure(expression, file, test_name, line);
+    for (int i = 0; i < operand_count; i++)
+        ctest__add_failure_operand(failure, operands[i].text, operands[i].value, operands[i].quoted);
+    ctest__end_failure(failure, msg, args);
+}
+
+static const char *ctest__format_value(ctest__value_t value, char *buffer, size_t size)
+{
+    switch (value.kind)
+    {
+    case CTEST__VALUE_SIGNED:
+        snprintf(buffer, size, "%lld", (long long)value.as.s);
+        break;
+    case CTEST__VALUE_UNSIGNED:
+        snprintf(buffer, size, "%llu", (unsigned long long)value.as.u);
+        break;
+    case CTEST__VALUE_DOUBLE:
+        // Shortest precision that reads back as the same value, so values differing in the last bit look different
+        for (int precision = 15; precision <= 17; precision++)
+        {
+            snprintf(buffer, size, "%.*g", precision, value.as.d);
+            if (strtod(buffer, NULL) == value.as.d)
+                break;
+        }
+        break;
+    case CTEST__VALUE_POINTER:
+        if (value.as.p == NULL)
+            snprintf(buffer, size, "NULL");
+        else
+            snprintf(buffer, size, "%p", value.as.p);
+        break;
+    }
+    return buffer;
+}
+
+static void ctest__parse_options(int argc, char **argv, ctest__options_t *options)
+{
+    const char *jobs = getenv("CTEST_JOBS");
+    options->jobs = (jobs != NULL && *jobs != '\0') ? ctest__parse_jobs(jobs) : 1;
+    const char *filter = getenv("CTEST_FILTER");
+    options->filter = (filter != NULL && *filter != '\0') ? filter : NULL;
+    const char *reporter = getenv("CTEST_REPORTER");
+    options->reporter = (reporter != NULL && *reporter != '\0') ? reporter : NULL;
+    const char *report_file = getenv("CTEST_REPORT_FILE");
+    options->report_file = (report_file != NULL && *report_file != '\0') ? report_file : NULL;
+    const char *timeout = getenv("CTEST_TIMEOUT");
+    options->timeout = (timeout != NULL && *timeout != '\0') ? ctest__parse_count(timeout, "milliseconds") : 0;
+    const char *shard_index = ctest__get_shard_env("SHARD_INDEX");
+    options->shard_index = shard_index != NULL ? ctest__parse_count(shard_index, "shard index") : 0;
+    const char *shard_count = ctest__get_shard_env("TOTAL_SHARDS");
+    options->shard_count = shard_count != NULL ? ctest__parse_count(shard_count, "shards") : 0;
+    const char *leaks = getenv("CTEST_LEAKS");
+    options->leaks = (leaks != NULL && *leaks != '\0') ? ctest__parse_leaks(leaks) : CTEST_LEAKS_OFF;
+    const char *trace = getenv("CTEST_TRACE");
+    options->trace = (trace != NULL && *trace != '\0') ? trace : NULL;
+    const char *cache = getenv("CTEST_CACHE");
+    options->cache = (cache != NULL && *cache != '\0') ? cache : NULL;
+    const char *cache_deps = getenv("CTEST_CACHE_DEPS");
+    options->cache_deps = (cache_deps != NULL && *cache_deps != '\0') ? cache_deps : NULL;
+    const char *durations = getenv("CTEST_DURATIONS");
+    options->durations = (durations != NULL && *durations != '\0') ? durations : NULL;
+    const char *isolate = getenv("CTEST_ISOLATE");
+    options->isolate = isolate != NULL && *isolate != '\0' && strcmp(isolate, "0") != 0;
+    const char *perf = getenv("CTEST_PERF");
+    options->perf = perf != NULL && *perf != '\0' && strcmp(perf, "0") != 0;
+    const char *slowest = getenv("CTEST_SLOWEST");
+    options->slowest = (slowest != NULL && *slowest != '\0') ? ctest__parse_count(slowest, "slowest tests")
+                                                              : CTEST_SLOWEST_DEFAULT;
+    const char *bench_time = getenv("CTEST_BENCH_TIME");
+    options->bench_time = (bench_time != NULL && *bench_time != '\0') ? ctest__parse_count(bench_time, "milliseconds")
+                                                                      : CTEST_BENCH_TIME_DEFAULT;
+    const char *bench_reps = getenv("CTEST_BENCH_REPS");
+    options->bench_reps = (bench_reps != NULL && *bench_reps != '\0') ? ctest__parse_count(bench_reps, "repetitions")
+                                                                      : CTEST_BENCH_REPS_DEFAULT;
+    const char *bench_save = getenv("CTEST_BENCH_SAVE");
+    options->bench_save = (bench_save != NULL && *bench_save != '\0') ? bench_save : NULL;
+    const char *bench_baseline = getenv("CTEST_BENCH_BASELINE");
+    options->bench_baseline = (bench_baseline != NULL && *bench_baseline != '\0') ? bench_baseline : NULL;
+    const char *bench_tolerance = getenv("CTEST_BENCH_TOLERANCE");
+    options->bench_tolerance = (bench_tolerance != NULL && *bench_tolerance != '\0')
+                                   ? ctest__parse_double(bench_tolerance, "tolerance")
+                                   : CTEST_BENCH_TOLERANCE_DEFAULT;
+    const char *bench_alpha = getenv("CTEST_BENCH_ALPHA");
+    options->bench_alpha = (bench_alpha != NULL && *bench_alpha != '\0') ? ctest__parse_double(bench_alpha, "alpha")
+                                                                         : CTEST_BENCH_ALPHA_DEFAULT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            // Accept '-jN', '-j N' and a bare '-j'
+            const char *value = &argv[i][2];
+            if (*value == '\0' && i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+                value = argv[++i];
+            options->jobs = ctest__parse_jobs(value);
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            options->filter = argv[++i];
+        }
+        else if (strncmp(argv[i], "--filter=", 9) == 0)
+        {
+            options->filter = &argv[i][9];
+        }
+        else if (strcmp(argv[i], "--list") == 0)
+        {
+            options->list = true;
+        }
+        else if (strcmp(argv[i], "--reporter") == 0 && i + 1 < argc)
+        {
+            options->reporter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--report-file") == 0 && i + 1 < argc)
+        {
+            options->report_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--isolate") == 0)
+        {
+            options->isolate = true;
+        }
+        else if (strcmp(argv[i], "--perf") == 0)
+        {
+            options->perf = true;
+        }
+        else if (strcmp(argv[i], "--shard-index") == 0 && i + 1 < argc)
+        {
+            options->shard_index = ctest__parse_count(argv[++i], "shard index");
+        }
+        else if (strcmp(argv[i], "--total-shards") == 0 && i + 1 < argc)
+        {
+            options->shard_count = ctest__parse_count(argv[++i], "shards");
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            options->trace = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            options->cache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-deps") == 0 && i + 1 < argc)
+        {
+            options->cache_deps = argv[++i];
+        }
+        else if (strcmp(argv[i], "--durations") == 0 && i + 1 < argc)
+        {
+            options->durations = argv[++i];
+        }
+        else if (strcmp(argv[i], "--leaks") == 0 && i + 1 < argc)
+        {
+            options->leaks = ctest__parse_leaks(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+        {
+            options->timeout = ctest__parse_count(argv[++i], "milliseconds");
+        }
+        else if (strcmp(argv[i], "--slowest") == 0 && i + 1 < argc)
+        {
+            options->slowest = ctest__parse_count(argv[++i], "slowest tests");
+        }
+        else if (strcmp(argv[i], "--bench-time") == 0 && i + 1 < argc)
+        {
+            options->bench_time = ctest__parse_count(argv[++i], "milliseconds");
+        }
+        else if (strcmp(argv[i], "--bench-reps") == 0 && i + 1 < argc)
+        {
+            options->bench_reps = ctest__parse_count(argv[++i], "repetitions");
+        }
+        else if (strcmp(argv[i], "--bench-save") == 0 && i + 1 < argc)
+        {
+            options->bench_save = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bench-baseline") == 0 && i + 1 < argc)
+        {
+            options->bench_baseline = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bench-tolerance") == 0 && i + 1 < argc)
+        {
+            options->bench_tolerance = ctest__parse_double(argv[++i], "tolerance");
+        }
+        else if (strcmp(argv[i], "--bench-alpha") == 0 && i + 1 < argc)
+        {
+            options->bench_alpha = ctest__parse_double(argv[++i], "alpha");
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Unknown argument '%s'!\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    if (options->shard_count > 0 && options->shard_index >= options->shard_count)
+    {
+        fprintf(stderr, "ERROR: Shard index %d is out of range of %d shards!\n", options->shard_index,
+                options->shard_count);
+        exit(1);
+    }
+    if (options->report_file != NULL && options->reporter == NULL)
+    {
+        fprintf(stderr, "ERROR: Report file '%s' needs a reporter!\n", options->report_file);
+        exit(1);
+    }
+    if (options->bench_reps < 1 || options->bench_reps > CTEST_BENCH_REPS_MAX)
+    {
+        fprintf(stderr, "ERROR: Number of benchmark repetitions must be between 1 and %d!\n", CTEST_BENCH_REPS_MAX);
+        exit(1);
+    }
+}
+
+static int ctest__parse_jobs(const char *value)
+{
+    char *end = NULL;
+    long jobs = *value != '\0' ? strtol(value, &end, 10) : 0;
+    if (end != NULL && (*end != '\0' || jobs < 0 || jobs > CTEST_MAX_JOBS))
+    {
+        fprintf(stderr, "ERROR: Invalid number of jobs '%s'!\n", value);
+        exit(1);
+    }
+    if (jobs == 0)
+    {
+        // Zero or no value selects one job per online CPU
+#ifdef _SC_NPROCESSORS_ONLN
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif // _SC_NPROCESSORS_ONLN
+        jobs = jobs < 1 ? 1 : (jobs > CTEST_MAX_JOBS ? CTEST_MAX_JOBS : jobs);
+    }
+    return (int)jobs;
+}
+
+static ctest__leaks_t ctest__parse_leaks(const char *value)
+{
+    if (strcmp(value, "report") == 0)
+        return CTEST_LEAKS_REPORT;
+    if (strcmp(value, "fail") == 0)
+        return CTEST_LEAKS_FAIL;
+    fprintf(stderr, "ERROR: Invalid leak check mode '%s', expected 'report' or 'fail'!\n", value);
+    exit(1);
+}
+
+static const char *ctest__get_shard_env(const char *name)
+{
+    // Variables of GoogleTest and Bazel are honored as well, so CI jobs sharding those binaries work unchanged
+    static const char *const prefixes[] = {"CTEST_", "GTEST_", "TEST_"};
+    char key[32];
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+    {
+        snprintf(key, sizeof(key), "%s%s", prefixes[i], name);
+        const char *value = getenv(key);
+        if (value != NULL && *value != '\0')
+            return value;
+    }
+    return NULL;
+}
+
+static uint64_t ctest__get_timeout_ns(const ctest__test_t *test)
+{
+    int timeout_ms = test->timeout_ms > 0 ? test->timeout_ms : ctest__options.timeout;
+    return (uint64_t)timeout_ms * 1000000u;
+}
+
+static void ctest__run_test(const ctest__test_t *test, ctest__result_t *result, ctest__failures_t *failures)
+{
+    // Failures are only recorded when a report needs them
+    failures->count = 0;
+    if (result->cached)
+    {
+        ctest__prepare_output();
+        ctest__print("💾 Test " CTEST_GRYB "%s" CTEST_GRY " cached, it passed before with the same inputs.\n", test->name);
+        ctest__flush_output();
+        return;
+    }
+    ctest__current_failures = ctest__options.reporter != NULL ? failures : NULL;
+    ctest__current_result = result;
+    ctest__prepare_output();
+    ctest__reset_arena();
+    ctest__reset_heap_stats();
+    uint64_t timeout_ns = ctest__get_timeout_ns(test);
+    ctest__perf_t perf_start;
+    if (ctest__options.perf)
+        ctest__read_perf(&perf_start);
+    uint64_t start_ns = ctest__get_time_ns();
+    result->failed_assertions = ctest__run_watched(test, timeout_ns, &result->timed_out);
+    result->duration_ns = ctest__get_time_ns() - start_ns;
+    if (ctest__options.perf)
+    {
+        ctest__read_perf(&result->perf);
+        ctest__sub_perf(&result->perf, &perf_start);
+    }
+    result->failed_assertions += ctest__release_test_fixture();
+    result->arena_bytes = ctest__get_arena_used();
+    ctest__get_heap_stats(result);
+    // Abandoned test never got to free its memory, its allocations are dropped without a report
+    result->failed_assertions += ctest__check_leaks(test, result, !result->timed_out);
+    if (ctest__options.trace != NULL)
+    {
+        char args[64];
+        snprintf(args, sizeof(args), "{\"status\":\"%s\"}", ctest__get_status(result));
+        ctest__trace_slice(test->name, "test", start_ns, start_ns + result->duration_ns, args);
+    }
+    ctest__current_result = NULL;
+    ctest__current_failures = NULL;
+
+    char duration[32];
+    if (result->timed_out)
+    {
+        ctest__format_duration((double)timeout_ns, duration, sizeof(duration));
+        ctest__print("⏰ Test " CTEST_GRYB "%s" CTEST_GRY " timed out after %s!\n", test->name, duration);
+        ctest__print_backtrace();
+        ctest__flush_output();
+        return;
+    }
+    // Arena usage is shown only for the tests using it, heap usage only when allocations are tracked
+    char details[256];
+    char size[32];
+    ctest__format_duration((double)result->duration_ns, duration, sizeof(duration));
+    int length = snprintf(details, sizeof(details), "%s", duration);
+    if (result->arena_bytes > 0)
+    {
+        length += snprintf(&details[length], sizeof(details) - length, ", %s arena",
+                           ctest__format_size((double)result->arena_bytes, size, sizeof(size)));
+    }
+    if (ctest__is_heap_tracked())
+    {
+        length += snprintf(&details[length], sizeof(details) - length, ", %" PRIu64 " allocs, peak %s",
+                           result->allocs, ctest__format_size((double)result->peak_heap_bytes, size, sizeof(size)));
+    }
+    if (result->perf.available != 0)
+    {
+        char counters[160];
+        snprintf(&details[length], sizeof(details) - length, ", %s",
+                 ctest__format_perf(&result->perf, 1.0, "", counters, sizeof(counters)));
+    }
+    if (result->failed_assertions > 0)
+    {
+        ctest__print("💥 Test " CTEST_GRYB "%s" CTEST_GRY " failed %d assertions! (%s)\n", test->name,
+                     result->failed_assertions, details);
+    }
+    else
+    {
+        ctest__print("✅ Test " CTEST_GRYB "%s" CTEST_GRY " passed. (%s)\n", test->name, details);
+    }
+    ctest__flush_output();
+}
+
+static void *ctest__worker(void *arg)
+{
+    ctest__run_t *run = (ctest__run_t *)arg;
+    ctest__failures_t failures;
+    for (;;)
+    {
+        int index = __atomic_fetch_add(&run->next_test, 1, __ATOMIC_RELAXED);
+        if (index >= run->test_count)
+            break;
+        ctest__run_test(&run->tests[index], &run->results[index], &failures);
+        ctest__report_test(run, index, &failures);
+        ctest__finish_watched();
+    }
+    ctest__free_arena();
+    ctest__close_perf();
+    ctest__free_trace();
+    return NULL;
+}
+
+#if CTEST__HAS_FORK
+static void ctest__run_processes(ctest__run_t *run, int workers)
+{
+    ctest__process_t *processes = (ctest__process_t *)calloc(workers, sizeof(ctest__process_t));
+    struct pollfd *fds = (struct pollfd *)calloc(workers, sizeof(struct pollfd));
+    int *polled = (int *)calloc(workers, sizeof(int));
+    if (processes == NULL || fds == NULL || polled == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for workers!\n");
+        exit(1);
+    }
+
+    // A worker dying between two tests must not take the runner down with SIGPIPE
+    void (*sigpipe_handler)(int) = signal(SIGPIPE, SIG_IGN);
+
+    // Workers are forked once up front and reused for all tests, a new one is forked only to replace a crashed one
+    int spawned = 0;
+    for (int slot = 0; slot < workers; slot++)
+        spawned += ctest__spawn_process(run, processes, workers, slot) ? 1 : 0;
+    if (spawned == 0)
+    {
+        fprintf(stderr, "ERROR: Could not start any worker process!\n");
+        exit(1);
+    }
+    for (int slot = 0; slot < workers; slot++)
+        ctest__dispatch_process(run, &processes[slot]);
+
+    for (;;)
+    {
+        int count = 0;
+        for (int slot = 0; slot < workers; slot++)
+        {
+            if (processes[slot].test >= 0)
+            {
+                fds[count].fd = processes[slot].result_fd;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                polled[count++] = slot;
+            }
+        }
+        if (count == 0)
+            break;
+        if (poll(fds, count, ctest__check_timeouts(processes, workers)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ERROR: Could not wait for worker processes!\n");
+            exit(1);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+            int slot = polled[i];
+            ctest__process_t *process = &processes[slot];
+            ctest__process_msg_t msg;
+            if (ctest__read_all(process->result_fd, &msg, sizeof(msg)) && msg.test == process->test)
+            {
+                run->results[msg.test] = msg.result;
+                ctest__report_test(run, msg.test, &msg.failures);
+                process->test = -1;
+                ctest__dispatch_process(run, process);
+            }
+            else
+            {
+                // End of file without a result, the worker died while running its test
+                ctest__finish_process(run, process);
+                if (run->next_test < run->test_count && ctest__spawn_process(run, processes, workers, slot))
+                    ctest__dispatch_process(run, process);
+            }
+        }
+    }
+
+    // Closing the task pipe tells an idle worker to exit
+    for (int slot = 0; slot < workers; slot++)
+        ctest__finish_process(run, &processes[slot]);
+    signal(SIGPIPE, sigpipe_handler);
+    free(polled);
+    free(fds);
+    free(processes);
+}
+
+static bool ctest__spawn_process(ctest__run_t *run, ctest__process_t *processes, int workers, int slot)
+{
+    int task_pipe[2];
+    int result_pipe[2];
+    if (pipe(task_pipe) != 0)
+        return false;
+    if (pipe(result_pipe) != 0)
+    {
+        close(task_pipe[0]);
+        close(task_pipe[1]);
+        return false;
+    }
+
+    // Anything left in the stdio buffers would be printed again by the child
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // The worker must not hold pipes of its siblings, otherwise they never see end of file
+        for (int i = 0; i < workers; i++)
+        {
+            if (processes[i].pid != 0)
+            {
+                close(processes[i].task_fd);
+                close(processes[i].result_fd);
+            }
+        }
+        close(task_pipe[1]);
+        close(result_pipe[0]);
+        signal(SIGPIPE, SIG_DFL);
+        ctest__init_process_timeout();
+        ctest__process_main(run, task_pipe[0], result_pipe[1]);
+        _exit(0);
+    }
+
+    close(task_pipe[0]);
+    close(result_pipe[1]);
+    if (pid < 0)
+    {
+        close(task_pipe[1]);
+        close(result_pipe[0]);
+        return false;
+    }
+    processes[slot].pid = pid;
+    processes[slot].task_fd = task_pipe[1];
+    processes[slot].result_fd = result_pipe[0];
+    processes[slot].test = -1;
+    return true;
+}
+
+static void ctest__process_main(ctest__run_t *run, int task_fd, int result_fd)
+{
+    int test;
+    while (ctest__read_all(task_fd, &test, sizeof(test)) && test >= 0 && test < run->test_count)
+    {
+        ctest__process_msg_t msg;
+        msg.test = test;
+        msg.result = run->results[test];
+        ctest__run_test(&run->tests[test], &msg.result, &msg.failures);
+        // Events of a worker process are written after every test, a later crash must not lose them
+        ctest__flush_trace();
+        fflush(stdout);
+        if (!ctest__write_all(result_fd, &msg, sizeof(msg)))
+            break;
+    }
+    ctest__teardown_fixtures(run->tests, run->test_count);
+    ctest__free_arena();
+    ctest__close_perf();
+    ctest__free_trace();
+}
+
+static void ctest__finish_process(ctest__run_t *run, ctest__process_t *process)
+{
+    if (process->pid == 0)
+        return;
+
+    close(process->task_fd);
+    close(process->result_fd);
+    int status = 0;
+    while (waitpid(process->pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    process->pid = 0;
+
+    if (process->test >= 0)
+    {
+        // The test never reported back, blame it for the death of the worker
+        const char *name = run->tests[process->test].name;
+        ctest__result_t *result = &run->results[process->test];
+        result->duration_ns = ctest__get_time_ns() - process->started_ns;
+        if (process->timed_out)
+        {
+            char duration[32];
+            ctest__format_duration((double)process->timeout_ns, duration, sizeof(duration));
+            result->timed_out = true;
+            ctest__print("⏰ Test " CTEST_GRYB "%s" CTEST_GRY " timed out after %s!\n", name, duration);
+        }
+        else if (WIFSIGNALED(status))
+        {
+            result->signal = WTERMSIG(status);
+            ctest__print("💀 Test " CTEST_GRYB "%s" CTEST_GRY " crashed with signal %d (%s)!\n", name, result->signal,
+                         strsignal(result->signal));
+        }
+        else
+        {
+            result->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+            ctest__print("💀 Test " CTEST_GRYB "%s" CTEST_GRY " exited with status %d!\n", name, result->exit_status);
+        }
+        ctest__flush_output();
+        ctest__report_test(run, process->test, NULL);
+        process->test = -1;
+    }
+}
+
+static bool ctest__dispatch_process(ctest__run_t *run, ctest__process_t *process)
+{
+    if (process->pid == 0 || run->next_test >= run->test_count)
+        return false;
+
+    process->test = run->next_test++;
+    process->started_ns = ctest__get_time_ns();
+    process->timeout_ns = ctest__get_timeout_ns(&run->tests[process->test]);
+    process->timed_out = false;
+    // A failed write means the worker is gone, which shows up as end of file on its result pipe
+    ctest__write_all(process->task_fd, &process->test, sizeof(process->test));
+    return true;
+}
+
+static int ctest__check_timeouts(ctest__process_t *processes, int workers)
+{
+    // Worker past its deadline is asked to write its backtrace and die, one ignoring that is killed after a grace time
+    uint64_t now_ns = ctest__get_time_ns();
+    uint64_t next_ns = UINT64_MAX;
+    for (int slot = 0; slot < workers; slot++)
+    {
+        ctest__process_t *process = &processes[slot];
+        if (process->pid == 0 || process->test < 0 || process->timeout_ns == 0)
+            continue;
+        uint64_t deadline_ns = process->started_ns + process->timeout_ns;
+        if (process->timed_out)
+            deadline_ns += (uint64_t)CTEST_TIMEOUT_GRACE_MS * 1000000u;
+        if (deadline_ns <= now_ns)
+        {
+            kill(process->pid, process->timed_out ? SIGKILL : CTEST_TIMEOUT_SIGNAL);
+            if (process->timed_out)
+                continue;
+            process->timed_out = true;
+            deadline_ns += (uint64_t)CTEST_TIMEOUT_GRACE_MS * 1000000u;
+        }
+        next_ns = deadline_ns < next_ns ? deadline_ns : next_ns;
+    }
+    if (next_ns == UINT64_MAX)
+        return -1;
+    uint64_t wait_ms = (next_ns - now_ns + 999999) / 1000000;
+    return wait_ms < INT32_MAX ? (int)wait_ms : INT32_MAX;
+}
+
+static bool ctest__read_all(int fd, void *data, size_t size)
+{
+    char *ptr = (char *)data;
+    while (size > 0)
+    {
+        ssize_t count = read(fd, ptr, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        ptr += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+static bool ctest__write_all(int fd, const void *data, size_t size)
+{
+    const char *ptr = (const char *)data;
+    while (size > 0)
+    {
+        ssize_t count = write(fd, ptr, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        ptr += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+#endif // CTEST__HAS_FORK
+
+static void ctest__print_slowest(FILE *console, const ctest__run_t *run, int slowest)
+{
+    if (slowest <= 0 || run->test_count == 0)
+        return;
+
+    ctest__timing_t *timings = (ctest__timing_t *)calloc(run->test_count, sizeof(ctest__timing_t));
+    if (timings == NULL)
+        return;
+    // Cached tests did not run, they have no duration to compare
+    int timing_count = 0;
+    for (int i = 0; i < run->test_count; i++)
+    {
+        if (run->results[i].cached)
+            continue;
+        timings[timing_count].duration_ns = run->results[i].duration_ns;
+        timings[timing_count].test = i;
+        timing_count++;
+    }
+    qsort(timings, timing_count, sizeof(ctest__timing_t), ctest__compare_timing);
+
+    char duration[32];
+    for (int i = 0; i < slowest && i < timing_count; i++)
+    {
+        fprintf(console, CTEST_GRY "%s" CTEST_RST "%-10s %s\n", i == 0 ? "  Slowest  " : "           ",
+                ctest__format_duration((double)timings[i].duration_ns, duration, sizeof(duration)),
+                run->tests[timings[i].test].name);
+    }
+    free(timings);
+}
+
+static void ctest__print_allocs(FILE *console, const ctest__run_t *run)
+{
+    if (!ctest__is_heap_tracked() || run->test_count == 0)
+        return;
+
+    uint64_t allocs = 0;
+    uint64_t alloc_bytes = 0;
+    int peak = 0;
+    for (int i = 0; i < run->test_count; i++)
+    {
+        allocs += run->results[i].allocs;
+        alloc_bytes += run->results[i].alloc_bytes;
+        peak = run->results[i].peak_heap_bytes > run->results[peak].peak_heap_bytes ? i : peak;
+    }
+    char bytes[32];
+    char peak_bytes[32];
+    fprintf(console, CTEST_GRY "   Allocs  " CTEST_RST "%" PRIu64 " allocations, %s, peak %s in %s\n", allocs,
+            ctest__format_size((double)alloc_bytes, bytes, sizeof(bytes)),
+            ctest__format_size((double)run->results[peak].peak_heap_bytes, peak_bytes, sizeof(peak_bytes)),
+            run->tests[peak].name);
+    if (ctest__options.leaks == CTEST_LEAKS_OFF)
+        return;
+
+    uint64_t leaked_allocs = 0;
+    uint64_t leaked_bytes = 0;
+    int leaking = 0;
+    for (int i = 0; i < run->test_count; i++)
+    {
+        leaked_allocs += run->results[i].leaked_allocs;
+        leaked_bytes += run->results[i].leaked_bytes;
+        leaking += run->results[i].leaked_allocs > 0 ? 1 : 0;
+    }
+    fprintf(console, CTEST_GRY "    Leaks  " CTEST_RST "%" PRIu64 " allocations, %s in %d tests\n", leaked_allocs,
+            ctest__format_size((double)leaked_bytes, bytes, sizeof(bytes)), leaking);
+}
+
+static void ctest__print_perf(FILE *console, const ctest__run_t *run)
+{
+    ctest__perf_t total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < run->test_count; i++)
+        ctest__add_perf(&total, &run->results[i].perf);
+    if (total.available == 0)
+        return;
+
+    char counters[160];
+    fprintf(console, CTEST_GRY " Counters  " CTEST_RST "%s\n",
+            ctest__format_perf(&total, 1.0, "", counters, sizeof(counters)));
+}
+
+static int ctest__compare_test(const void *a, const void *b)
+{
+    const ctest__test_t *test_a = (const ctest__test_t *)a;
+    const ctest__test_t *test_b = (const ctest__test_t *)b;
+    int order = strcmp(test_a->file, test_b->file);
+    return order != 0 ? order : test_a->line - test_b->line;
+}
+
+static const char *ctest__format_timestamp(time_t time, char *buffer, size_t size)
+{
+    struct tm local;
+    if (localtime_r(&time, &local) == NULL || strftime(buffer, size, "%H:%M:%S", &local) == 0)
+        snprintf(buffer, size, "--:--:--");
+    return buffer;
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
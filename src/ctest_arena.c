@@ -0,0 +1,154 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_arena.c
+ * @brief       Arena tests allocate temporary memory from, reset in constant time before every test.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Size of the first block of an arena, later blocks double in size.
+ */
+#define CTEST_ARENA_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief   Alignment of every allocation, enough for any type like the memory returned by malloc.
+ */
+#define CTEST_ARENA_ALIGN __alignof__(max_align_t)
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Block of memory allocations are carved from, followed by its data.
+ */
+typedef struct ctest__arena_block
+{
+    struct ctest__arena_block *next; // Next block, the blocks after the current one are free
+    size_t size;                     // Size of the data of the block
+    max_align_t data[];              // Data of the block
+} ctest__arena_block_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static void *ctest__grow_arena(size_t size);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Blocks of the arena of the calling thread, kept across tests so they are reused.
+ */
+static __thread ctest__arena_block_t *ctest__arena_blocks;
+
+/**
+ * @brief   Block allocations are currently carved from, NULL before the first allocation.
+ */
+static __thread ctest__arena_block_t *ctest__arena_block;
+
+/**
+ * @brief   Bytes used of the current block.
+ */
+static __thread size_t ctest__arena_offset;
+
+/**
+ * @brief   Bytes allocated since the last reset.
+ */
+static __thread size_t ctest__arena_used;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+void *ctest_alloc(size_t size)
+{
+    size_t aligned = (size + CTEST_ARENA_ALIGN - 1) & ~(size_t)(CTEST_ARENA_ALIGN - 1);
+    if (aligned < size)
+        return NULL;
+
+    // Bump allocation, blocks are only touched when the current one is full
+    ctest__arena_block_t *block = ctest__arena_block;
+    if (block == NULL || block->size - ctest__arena_offset < aligned)
+        return ctest__grow_arena(aligned);
+    void *data = (char *)block->data + ctest__arena_offset;
+    ctest__arena_offset += aligned;
+    ctest__arena_used += aligned;
+    return data;
+}
+
+void ctest__reset_arena(void)
+{
+    // Memory of the previous test is given up at once, the blocks stay allocated for the next test
+    ctest__arena_block = ctest__arena_blocks;
+    ctest__arena_offset = 0;
+    ctest__arena_used = 0;
+}
+
+size_t ctest__get_arena_used(void)
+{
+    return ctest__arena_used;
+}
+
+void ctest__free_arena(void)
+{
+    while (ctest__arena_blocks != NULL)
+    {
+        ctest__arena_block_t *next = ctest__arena_blocks->next;
+        free(ctest__arena_blocks);
+        ctest__arena_blocks = next;
+    }
+    ctest__arena_block = NULL;
+    ctest__arena_offset = 0;
+    ctest__arena_used = 0;
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static void *ctest__grow_arena(size_t size)
+{
+    // Blocks after the current one are free since the last reset, the first one large enough becomes current. A block
+    // too small for this allocation is skipped until the next test.
+    ctest__arena_block_t *previous = ctest__arena_block;
+    ctest__arena_block_t *block = previous != NULL ? previous->next : ctest__arena_blocks;
+    while (block != NULL && block->size < size)
+    {
+        previous = block;
+        block = block->next;
+    }
+
+    if (block == NULL)
+    {
+        size_t block_size = previous != NULL ? previous->size * 2 : CTEST_ARENA_BLOCK_SIZE;
+        block_size = block_size > size ? block_size : size;
+        if (block_size > SIZE_MAX - sizeof(ctest__arena_block_t))
+            return NULL;
+        // Arena blocks outlive the test that needed them first, they are ctest's own memory
+        ctest__pause_heap_tracking();
+        block = (ctest__arena_block_t *)malloc(sizeof(ctest__arena_block_t) + block_size);
+        ctest__resume_heap_tracking();
+        if (block == NULL)
+            return NULL;
+        block->next = NULL;
+        block->size = block_size;
+        if (previous != NULL)
+            previous->next = block;
+        else
+            ctest__arena_blocks = block;
+    }
+
+    ctest__arena_block = block;
+    ctest__arena_offset = size;
+    ctest__arena_used += size;
+    return block->data;
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,308 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_bench.c
+ * @brief       Benchmark measurement, statistics and baseline comparison of CTest.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Baseline measurements of a benchmark, loaded from a baseline file.
+ */
+typedef struct
+{
+    char *name;           // Name of the benchmark
+    ctest__bench_t bench; // Measurements of the baseline run
+} ctest__baseline_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static int ctest__load_baseline(const char *path, ctest__baseline_t **baseline);
+static void ctest__save_baseline(const char *path, const ctest__run_t *run);
+static int ctest__compare_baseline(const ctest__run_t *run, const ctest__baseline_t *baseline, int count,
+                                   int *compared);
+static double ctest__mann_whitney(const ctest__bench_t *baseline, const ctest__bench_t *current);
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+int ctest__run_bench(const char *name, ctest__bench_fn_t fn)
+{
+    ctest__bench_t local;
+    ctest__bench_t *bench = ctest__current_result != NULL ? &ctest__current_result->bench : &local;
+    int repetitions = ctest__options.bench_reps > 0 ? ctest__options.bench_reps : CTEST_BENCH_REPS_DEFAULT;
+    int bench_time = ctest__options.bench_time > 0 ? ctest__options.bench_time : CTEST_BENCH_TIME_DEFAULT;
+    uint64_t target_ns = (uint64_t)bench_time * 1000000u / (uint64_t)repetitions;
+
+    // Grow the iteration count until a single repetition takes the target time
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        uint64_t start_ns = ctest__get_time_ns();
+        int failed_assertions = fn(iterations);
+        uint64_t elapsed_ns = ctest__get_time_ns() - start_ns;
+        if (failed_assertions > 0)
+            return failed_assertions;
+        if (elapsed_ns >= target_ns || iterations >= UINT32_MAX)
+            break;
+
+        // Aim 20% past the prediction so the next attempt most likely reaches the target
+        uint64_t next = elapsed_ns > 0 ? iterations * target_ns / elapsed_ns : iterations * 100u;
+        next += next / 5u;
+        next = next > iterations * 100u ? iterations * 100u : next;
+        iterations = next > iterations ? next : iterations + 1u;
+    }
+
+    int failed_assertions = 0;
+    bench->iterations = iterations;
+    bench->repetitions = repetitions;
+    ctest__perf_t perf_start;
+    if (ctest__options.perf)
+        ctest__read_perf(&perf_start);
+    for (int i = 0; i < repetitions; i++)
+    {
+        uint64_t start_ns = ctest__get_time_ns();
+        failed_assertions += fn(iterations);
+        bench->samples_ns[i] = (double)(ctest__get_time_ns() - start_ns) / (double)iterations;
+    }
+    // Counters are read around all repetitions, reading them per repetition would add a system call to every sample
+    memset(&bench->perf, 0, sizeof(bench->perf));
+    if (ctest__options.perf)
+    {
+        ctest__read_perf(&bench->perf);
+        ctest__sub_perf(&bench->perf, &perf_start);
+    }
+    qsort(bench->samples_ns, repetitions, sizeof(double), ctest__compare_double);
+
+    ctest__bench_stats_t stats;
+    ctest__get_bench_stats(bench, &stats);
+    char mean[32], rate[32], min[32], median[32], p99[32], stddev[32];
+    ctest__print("⏱️  Bench " CTEST_GRYB "%s" CTEST_GRY " %s/op | %s ops/s | min %s | median %s | p99 %s | stddev %s "
+                 "(%d x %" PRIu64 " iterations)\n",
+                 name, ctest__format_duration(stats.mean_ns, mean, sizeof(mean)),
+                 ctest__format_rate(stats.mean_ns > 0 ? 1e9 / stats.mean_ns : 0.0, rate, sizeof(rate)),
+                 ctest__format_duration(stats.min_ns, min, sizeof(min)),
+                 ctest__format_duration(stats.median_ns, median, sizeof(median)),
+                 ctest__format_duration(stats.p99_ns, p99, sizeof(p99)),
+                 ctest__format_duration(stats.stddev_ns, stddev, sizeof(stddev)), repetitions, iterations);
+    if (bench->perf.available != 0)
+    {
+        char counters[160];
+        ctest__print("   Counters %s\n", ctest__format_perf(&bench->perf, (double)iterations * repetitions, "/op",
+                                                            counters, sizeof(counters)));
+    }
+    return failed_assertions;
+}
+
+int ctest__check_benches(const ctest__run_t *run, int *compared)
+{
+    // Baseline is compared before it is saved, so both may name the same file
+    int regressed = 0;
+    *compared = 0;
+    if (ctest__options.bench_baseline != NULL)
+    {
+        ctest__baseline_t *baseline = NULL;
+        int count = ctest__load_baseline(ctest__options.bench_baseline, &baseline);
+        regressed = ctest__compare_baseline(run, baseline, count, compared);
+        for (int i = 0; i < count; i++)
+            free(baseline[i].name);
+        free(baseline);
+    }
+    if (ctest__options.bench_save != NULL)
+        ctest__save_baseline(ctest__options.bench_save, run);
+    return regressed;
+}
+
+void ctest__get_bench_stats(const ctest__bench_t *bench, ctest__bench_stats_t *stats)
+{
+    int count = bench->repetitions;
+    memset(stats, 0, sizeof(*stats));
+    if (count < 1)
+        return;
+
+    double sum = 0.0;
+    for (int i = 0; i < count; i++)
+        sum += bench->samples_ns[i];
+    stats->mean_ns = sum / count;
+
+    double squares = 0.0;
+    for (int i = 0; i < count; i++)
+        squares += (bench->samples_ns[i] - stats->mean_ns) * (bench->samples_ns[i] - stats->mean_ns);
+    stats->stddev_ns = count > 1 ? sqrt(squares / (count - 1)) : 0.0;
+
+    // Samples are sorted, percentiles use the nearest rank
+    stats->min_ns = bench->samples_ns[0];
+    stats->median_ns = count % 2 ? bench->samples_ns[count / 2]
+                                 : (bench->samples_ns[count / 2 - 1] + bench->samples_ns[count / 2]) / 2.0;
+    stats->p99_ns = bench->samples_ns[(int)ceil(0.99 * count) - 1];
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static int ctest__load_baseline(const char *path, ctest__baseline_t **baseline)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "WARNING: Benchmark baseline '%s' could not be opened, nothing to compare against.\n", path);
+        return 0;
+    }
+
+    // One benchmark per line: name, iterations, repetitions and the samples in nanoseconds per operation
+    int count = 0;
+    int capacity = 0;
+    char name[256];
+    uint64_t iterations;
+    int repetitions;
+    while (fscanf(file, " %255s", name) == 1)
+    {
+        if (name[0] == '#')
+        {
+            fscanf(file, "%*[^\n]");
+            continue;
+        }
+        if (fscanf(file, "%" SCNu64 " %d", &iterations, &repetitions) != 2 || repetitions < 1 ||
+            repetitions > CTEST_BENCH_REPS_MAX)
+            break;
+        if (count == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 16;
+            ctest__baseline_t *grown = (ctest__baseline_t *)realloc(*baseline, capacity * sizeof(ctest__baseline_t));
+            if (grown == NULL)
+                break;
+            *baseline = grown;
+        }
+
+        ctest__baseline_t *entry = &(*baseline)[count];
+        entry->bench.iterations = iterations;
+        entry->bench.repetitions = repetitions;
+        int read = 0;
+        while (read < repetitions && fscanf(file, "%lf", &entry->bench.samples_ns[read]) == 1)
+            read++;
+        if (read < repetitions || (entry->name = strdup(name)) == NULL)
+            break;
+        qsort(entry->bench.samples_ns, repetitions, sizeof(double), ctest__compare_double);
+        count++;
+    }
+
+    if (!feof(file))
+        fprintf(stderr, "WARNING: Benchmark baseline '%s' is malformed, only %d entries were loaded.\n", path, count);
+    fclose(file);
+    return count;
+}
+
+static void ctest__save_baseline(const char *path, const ctest__run_t *run)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not write benchmark baseline '%s'!\n", path);
+        return;
+    }
+
+    fprintf(file, "# ctest benchmark baseline: name iterations repetitions samples[ns/op]...\n");
+    for (int i = 0; i < run->test_count; i++)
+    {
+        const ctest__bench_t *bench = &run->results[i].bench;
+        if (bench->repetitions < 1)
+            continue;
+        fprintf(file, "%s %" PRIu64 " %d", run->tests[i].name, bench->iterations, bench->repetitions);
+        for (int j = 0; j < bench->repetitions; j++)
+            fprintf(file, " %.9g", bench->samples_ns[j]);
+        fprintf(file, "\n");
+    }
+    fclose(file);
+}
+
+static int ctest__compare_baseline(const ctest__run_t *run, const ctest__baseline_t *baseline, int count,
+                                   int *compared)
+{
+    int regressed = 0;
+    *compared = 0;
+    for (int i = 0; i < run->test_count; i++)
+    {
+        const ctest__bench_t *bench = &run->results[i].bench;
+        if (bench->repetitions < 1)
+            continue;
+
+        const ctest__baseline_t *entry = NULL;
+        for (int j = 0; j < count && entry == NULL; j++)
+            entry = strcmp(baseline[j].name, run->tests[i].name) == 0 ? &baseline[j] : NULL;
+        if (entry == NULL)
+            continue;
+
+        // A regression needs a slowdown above the tolerance that is also statistically significant
+        ctest__bench_stats_t before, after;
+        ctest__get_bench_stats(&entry->bench, &before);
+        ctest__get_bench_stats(bench, &after);
+        double change = before.median_ns > 0 ? (after.median_ns / before.median_ns - 1.0) * 100.0 : 0.0;
+        double p = ctest__mann_whitney(&entry->bench, bench);
+        bool regression = change > ctest__options.bench_tolerance && p < ctest__options.bench_alpha;
+
+        char median_before[32], median_after[32];
+        fprintf(stderr, "%s Bench " CTEST_GRYB "%s" CTEST_GRY "%s median %s -> %s (%+.1f%%, p = %.3g)\n",
+                regression ? "📉" : "📊", run->tests[i].name, regression ? " regressed!" : "",
+                ctest__format_duration(before.median_ns, median_before, sizeof(median_before)),
+                ctest__format_duration(after.median_ns, median_after, sizeof(median_after)), change, p);
+        regressed += regression ? 1 : 0;
+        (*compared)++;
+    }
+    return regressed;
+}
+
+static double ctest__mann_whitney(const ctest__bench_t *baseline, const ctest__bench_t *current)
+{
+    // One-sided Mann-Whitney U test of the current samples being slower, using the normal approximation with tie and
+    // continuity correction. Both sample sets are sorted, so ranks come from a merge.
+    int n1 = baseline->repetitions;
+    int n2 = current->repetitions;
+    double n = n1 + n2;
+    double rank_sum = 0.0;
+    double ties = 0.0;
+    int i = 0;
+    int j = 0;
+    while (i < n1 || j < n2)
+    {
+        double value = (j >= n2 || (i < n1 && baseline->samples_ns[i] < current->samples_ns[j]))
+                           ? baseline->samples_ns[i]
+                           : current->samples_ns[j];
+        int first_rank = i + j + 1;
+        int in_current = 0;
+        while (i < n1 && baseline->samples_ns[i] == value)
+            i++;
+        while (j < n2 && current->samples_ns[j] == value)
+        {
+            j++;
+            in_current++;
+        }
+        double tied = (double)(i + j + 1 - first_rank);
+        rank_sum += in_current * (first_rank + (tied - 1.0) / 2.0);
+        ties += tied * tied * tied - tied;
+    }
+
+    double u = rank_sum - n2 * (n2 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return 1.0;
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,210 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_cache.c
+ * @brief       Cache of passed test results, keyed on the content of the test binary and the inputs of each test.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif // __APPLE__
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Version of the cache keys, changing it invalidates every cached result.
+ */
+#define CTEST_CACHE_VERSION 1
+
+/**
+ * @brief   Size of the chunks files are hashed in, a multiple of the word size.
+ */
+#define CTEST_CACHE_CHUNK_SIZE (64 * 1024)
+
+/**
+ * @brief   Longest path of an input file or a cache entry.
+ */
+#define CTEST_CACHE_PATH_MAX 4096
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static bool ctest__hash_binary(uint64_t *hash);
+static bool ctest__hash_files(const char *files, uint64_t *hash, const char **missing, char *buffer, size_t size);
+static bool ctest__hash_file(const char *path, uint64_t *hash);
+static uint64_t ctest__hash_bytes(uint64_t hash, const void *data, size_t size);
+static void ctest__get_entry_path(const char *dir, uint64_t key, char *buffer, size_t size);
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+int ctest__check_cache(const char *dir, const char *deps, const ctest__test_t *tests, int test_count,
+                       ctest__result_t *results)
+{
+    // Binary changes with any code the tests run, dependencies named by the user replace it when builds are not
+    // reproducible or the binary embeds a build time
+    uint64_t base = ctest__hash_bytes(0, "ctest", 5) ^ CTEST_CACHE_VERSION;
+    char path[CTEST_CACHE_PATH_MAX];
+    const char *missing = NULL;
+    if (deps != NULL && !ctest__hash_files(deps, &base, &missing, path, sizeof(path)))
+    {
+        fprintf(stderr, "WARNING: Cache dependency '%s' could not be read, every test runs.\n", missing);
+        return 0;
+    }
+    if (deps == NULL && !ctest__hash_binary(&base))
+    {
+        fprintf(stderr, "WARNING: Test binary could not be read, every test runs.\n");
+        return 0;
+    }
+    // Options a passing test can fail under are part of the key, so a stricter run does not reuse the result
+    int leaks = (int)ctest__options.leaks;
+    base = ctest__hash_bytes(base, &leaks, sizeof(leaks));
+
+    int cached_count = 0;
+    for (int i = 0; i < test_count; i++)
+    {
+        // Tests are static, files may reuse a name, so the place of the test tells them apart
+        uint64_t key = ctest__hash_bytes(base, tests[i].name, strlen(tests[i].name));
+        key = ctest__hash_bytes(key, tests[i].file, strlen(tests[i].file));
+        key = ctest__hash_bytes(key, &tests[i].line, sizeof(tests[i].line));
+        int timeout_ms = tests[i].timeout_ms > 0 ? tests[i].timeout_ms : ctest__options.timeout;
+        key = ctest__hash_bytes(key, &timeout_ms, sizeof(timeout_ms));
+        if (tests[i].inputs != NULL && !ctest__hash_files(tests[i].inputs, &key, &missing, path, sizeof(path)))
+        {
+            fprintf(stderr, "WARNING: Input '%s' of test %s could not be read, the test runs.\n", missing,
+                    tests[i].name);
+            continue;
+        }
+        // Key 0 marks a test that cannot be cached
+        results[i].cache_key = key != 0 ? key : 1;
+        ctest__get_entry_path(dir, results[i].cache_key, path, sizeof(path));
+        results[i].cached = access(path, F_OK) == 0;
+        cached_count += results[i].cached ? 1 : 0;
+    }
+    return cached_count;
+}
+
+void ctest__save_cache(const char *dir, const ctest__run_t *run)
+{
+    // Entries are files named by their key, so parallel runs and shards share a directory without a lock. They hold
+    // the place of the test only for whoever looks into the directory.
+    mkdir(dir, 0755);
+    char path[CTEST_CACHE_PATH_MAX];
+    for (int i = 0; i < run->test_count; i++)
+    {
+        const ctest__result_t *result = &run->results[i];
+        bool passed = strcmp(ctest__get_status(result), "passed") == 0;
+        if (!passed || result->cache_key == 0 || result->bench.iterations > 0)
+            continue;
+        ctest__get_entry_path(dir, result->cache_key, path, sizeof(path));
+        FILE *file = fopen(path, "w");
+        if (file == NULL)
+        {
+            fprintf(stderr, "ERROR: Could not write test cache '%s'!\n", dir);
+            return;
+        }
+        fprintf(file, "%s:%d %s\n", run->tests[i].file, run->tests[i].line, run->tests[i].name);
+        fclose(file);
+    }
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static bool ctest__hash_binary(uint64_t *hash)
+{
+#if defined(__linux__)
+    return ctest__hash_file("/proc/self/exe", hash);
+#elif defined(__APPLE__)
+    char path[CTEST_CACHE_PATH_MAX];
+    uint32_t size = sizeof(path);
+    return _NSGetExecutablePath(path, &size) == 0 && ctest__hash_file(path, hash);
+#else
+    (void)hash;
+    return false;
+#endif // __linux__
+}
+
+static bool ctest__hash_files(const char *files, uint64_t *hash, const char **missing, char *buffer, size_t size)
+{
+    // Path is hashed along with the content, so swapping the content of two inputs changes the key
+    while (*files != '\0')
+    {
+        size_t length = strcspn(files, ",");
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(buffer, files, copied);
+        buffer[copied] = '\0';
+        files += files[length] == ',' ? length + 1 : length;
+        if (copied == 0)
+            continue;
+        *hash = ctest__hash_bytes(*hash, buffer, copied);
+        if (!ctest__hash_file(buffer, hash))
+        {
+            *missing = buffer;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ctest__hash_file(const char *path, uint64_t *hash)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    uint8_t *chunk = (uint8_t *)malloc(CTEST_CACHE_CHUNK_SIZE);
+    if (chunk == NULL)
+    {
+        fclose(file);
+        return false;
+    }
+    size_t read;
+    while ((read = fread(chunk, 1, CTEST_CACHE_CHUNK_SIZE, file)) > 0)
+        *hash = ctest__hash_bytes(*hash, chunk, read);
+    bool ok = ferror(file) == 0;
+    free(chunk);
+    fclose(file);
+    return ok;
+}
+
+static uint64_t ctest__hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    // Word at a time multiply and shift, fast enough to hash a large test binary on every run. Not cryptographic, a
+    // cache entry is only as trustworthy as the directory holding it.
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, &bytes[i], sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15u;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = (uint64_t)size << 56;
+    memcpy(&tail, &bytes[i], size - i);
+    hash = (hash ^ tail) * 0xff51afd7ed558ccdu;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static void ctest__get_entry_path(const char *dir, uint64_t key, char *buffer, size_t size)
+{
+    snprintf(buffer, size, "%s/%016" PRIx64, dir, key);
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,266 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_durations.c
+ * @brief       Durations of tests kept between runs, the longest first order and the shards built from them.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Duration of a test recorded by an earlier run.
+ */
+typedef struct
+{
+    char *name;           // Name of the test
+    uint64_t duration_ns; // Duration of the test in nanoseconds
+} ctest__duration_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static int ctest__load_durations(const char *path, ctest__duration_t **durations);
+static ctest__duration_t *ctest__find_duration(ctest__duration_t *durations, int count, const char *name);
+static void ctest__free_durations(ctest__duration_t *durations, int count);
+static uint32_t ctest__hash_name(const char *name);
+static int ctest__compare_duration(const void *a, const void *b);
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+void ctest__schedule_tests(ctest__test_t *tests, int test_count, const char *path)
+{
+    ctest__duration_t *durations = NULL;
+    int count = ctest__load_durations(path, &durations);
+    if (count == 0)
+    {
+        ctest__free_durations(durations, count);
+        return;
+    }
+
+    // Ordering is only an optimization, without memory the tests keep their order
+    ctest__timing_t *timings = (ctest__timing_t *)malloc(test_count * sizeof(ctest__timing_t));
+    ctest__test_t *sorted = (ctest__test_t *)malloc(test_count * sizeof(ctest__test_t));
+    if (timings != NULL && sorted != NULL)
+    {
+        // Tests without history could be the longest of all, they are started first to be on the safe side
+        for (int i = 0; i < test_count; i++)
+        {
+            const ctest__duration_t *duration = ctest__find_duration(durations, count, tests[i].name);
+            timings[i].duration_ns = duration != NULL ? duration->duration_ns : UINT64_MAX;
+            timings[i].test = i;
+        }
+        qsort(timings, test_count, sizeof(ctest__timing_t), ctest__compare_timing);
+        for (int i = 0; i < test_count; i++)
+            sorted[i] = tests[timings[i].test];
+        memcpy(tests, sorted, test_count * sizeof(ctest__test_t));
+    }
+    free(sorted);
+    free(timings);
+    ctest__free_durations(durations, count);
+}
+
+void ctest__save_durations(const char *path, const ctest__run_t *run)
+{
+    // Tests that did not run keep their entries, so a filtered run does not lose the history of the others
+    ctest__duration_t *durations = NULL;
+    int count = ctest__load_durations(path, &durations);
+
+    // Written next to the file and renamed over it, an interrupted run never leaves a truncated file behind
+    size_t length = strlen(path);
+    char *temp_path = (char *)malloc(length + sizeof(".tmp"));
+    FILE *file = NULL;
+    if (temp_path != NULL)
+    {
+        memcpy(temp_path, path, length);
+        memcpy(&temp_path[length], ".tmp", sizeof(".tmp"));
+        file = fopen(temp_path, "w");
+    }
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not write test durations '%s'!\n", path);
+        free(temp_path);
+        ctest__free_durations(durations, count);
+        return;
+    }
+
+    fprintf(file, "# ctest durations: name duration[ns]\n");
+    for (int i = 0; i < run->test_count; i++)
+    {
+        // Cached test did not run, its previous duration is kept
+        if (run->results[i].cached)
+            continue;
+        fprintf(file, "%s %" PRIu64 "\n", run->tests[i].name, run->results[i].duration_ns);
+        ctest__duration_t *duration = ctest__find_duration(durations, count, run->tests[i].name);
+        if (duration != NULL)
+            duration->duration_ns = UINT64_MAX;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (durations[i].duration_ns != UINT64_MAX)
+            fprintf(file, "%s %" PRIu64 "\n", durations[i].name, durations[i].duration_ns);
+    }
+    if (fclose(file) != 0 || rename(temp_path, path) != 0)
+    {
+        fprintf(stderr, "ERROR: Could not write test durations '%s'!\n", path);
+        remove(temp_path);
+    }
+    free(temp_path);
+    ctest__free_durations(durations, count);
+}
+
+int ctest__shard_tests(ctest__test_t *tests, int test_count, int shard_index, int shard_count, const char *path)
+{
+    ctest__duration_t *durations = NULL;
+    int count = path != NULL ? ctest__load_durations(path, &durations) : 0;
+    bool *selected = (bool *)calloc(test_count + 1, sizeof(bool));
+    ctest__timing_t *timings = (ctest__timing_t *)malloc((test_count + 1) * sizeof(ctest__timing_t));
+    uint64_t *loads = (uint64_t *)calloc(shard_count, sizeof(uint64_t));
+    if (selected == NULL || timings == NULL || loads == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for test shards!\n");
+        exit(1);
+    }
+
+    int known_count = 0;
+    uint64_t known_ns = 0;
+    for (int i = 0; i < test_count; i++)
+    {
+        const ctest__duration_t *duration = ctest__find_duration(durations, count, tests[i].name);
+        timings[i].duration_ns = duration != NULL ? duration->duration_ns : UINT64_MAX;
+        timings[i].test = i;
+        if (duration != NULL)
+        {
+            known_ns += duration->duration_ns;
+            known_count++;
+        }
+    }
+
+    if (known_count > 0)
+    {
+        // Longest test goes to the least loaded shard, tests without history are assumed to take the mean duration.
+        // Shards only agree on the split when they all read the same durations file.
+        uint64_t mean_ns = known_ns / known_count;
+        for (int i = 0; i < test_count; i++)
+            timings[i].duration_ns = timings[i].duration_ns == UINT64_MAX ? mean_ns : timings[i].duration_ns;
+        qsort(timings, test_count, sizeof(ctest__timing_t), ctest__compare_timing);
+        for (int i = 0; i < test_count; i++)
+        {
+            int shard = 0;
+            for (int j = 1; j < shard_count; j++)
+                shard = loads[j] < loads[shard] ? j : shard;
+            loads[shard] += timings[i].duration_ns;
+            selected[timings[i].test] = shard == shard_index;
+        }
+    }
+    else
+    {
+        // Hash of the name keeps a test on its shard when other tests are added or removed
+        for (int i = 0; i < test_count; i++)
+            selected[i] = ctest__hash_name(tests[i].name) % (uint32_t)shard_count == (uint32_t)shard_index;
+    }
+
+    int shard_test_count = 0;
+    for (int i = 0; i < test_count; i++)
+    {
+        if (selected[i])
+            tests[shard_test_count++] = tests[i];
+    }
+    free(loads);
+    free(timings);
+    free(selected);
+    ctest__free_durations(durations, count);
+    return shard_test_count;
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static int ctest__load_durations(const char *path, ctest__duration_t **durations)
+{
+    // First run has no history yet, which is not worth a warning
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+
+    // One test per line: name and duration in nanoseconds
+    int count = 0;
+    int capacity = 0;
+    char name[256];
+    uint64_t duration_ns;
+    while (fscanf(file, " %255s", name) == 1)
+    {
+        if (name[0] == '#')
+        {
+            fscanf(file, "%*[^\n]");
+            continue;
+        }
+        if (fscanf(file, "%" SCNu64, &duration_ns) != 1)
+            break;
+        if (count == capacity)
+        {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            ctest__duration_t *grown = (ctest__duration_t *)realloc(*durations, capacity * sizeof(ctest__duration_t));
+            if (grown == NULL)
+                break;
+            *durations = grown;
+        }
+        ctest__duration_t *entry = &(*durations)[count];
+        entry->duration_ns = duration_ns;
+        if ((entry->name = strdup(name)) == NULL)
+            break;
+        count++;
+    }
+
+    if (!feof(file))
+        fprintf(stderr, "WARNING: Test durations '%s' are malformed, only %d entries were loaded.\n", path, count);
+    fclose(file);
+
+    // Sorted by name, so looking up every test of a large suite stays cheap
+    if (count > 0)
+        qsort(*durations, count, sizeof(ctest__duration_t), ctest__compare_duration);
+    return count;
+}
+
+static ctest__duration_t *ctest__find_duration(ctest__duration_t *durations, int count, const char *name)
+{
+    if (count == 0)
+        return NULL;
+    ctest__duration_t key = {(char *)name, 0};
+    return (ctest__duration_t *)bsearch(&key, durations, count, sizeof(ctest__duration_t), ctest__compare_duration);
+}
+
+static void ctest__free_durations(ctest__duration_t *durations, int count)
+{
+    for (int i = 0; i < count; i++)
+        free(durations[i].name);
+    free(durations);
+}
+
+static uint32_t ctest__hash_name(const char *name)
+{
+    // FNV-1a, the same on every machine and compiler
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++)
+        hash = (hash ^ *c) * 16777619u;
+    return hash;
+}
+
+static int ctest__compare_duration(const void *a, const void *b)
+{
+    return strcmp(((const ctest__duration_t *)a)->name, ((const ctest__duration_t *)b)->name);
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
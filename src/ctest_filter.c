@@ -0,0 +1,170 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_filter.c
+ * @brief       Glob based selection of the tests to run.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest_internal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static bool ctest__match_glob(const ctest__glob_t *glob, const char *name, size_t length);
+static bool ctest__match_piece(const ctest__glob_piece_t *piece, const char *text);
+static const char *ctest__find_piece(const ctest__glob_piece_t *piece, const char *text, const char *end);
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+bool ctest__compile_filter(const char *patterns, ctest__filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+    size_t size = strlen(patterns);
+    filter->storage = (char *)malloc(size + 1);
+    // Every pattern and every piece of a pattern is at least one character, so the length bounds both counts
+    filter->globs = (ctest__glob_t *)calloc(size + 1, sizeof(ctest__glob_t));
+    filter->pieces = (ctest__glob_piece_t *)calloc(size + 1, sizeof(ctest__glob_piece_t));
+    if (filter->storage == NULL || filter->globs == NULL || filter->pieces == NULL)
+    {
+        ctest__free_filter(filter);
+        return false;
+    }
+    memcpy(filter->storage, patterns, size + 1);
+
+    // Patterns are separated by ',' or ':', a leading '-' excludes the tests matching the pattern
+    int piece_count = 0;
+    for (char *pattern = strtok(filter->storage, ",:"); pattern != NULL; pattern = strtok(NULL, ",:"))
+    {
+        ctest__glob_t *glob = &filter->globs[filter->glob_count];
+        glob->negative = pattern[0] == '-';
+        pattern += glob->negative ? 1 : 0;
+        size_t length = strlen(pattern);
+        if (length == 0)
+            continue;
+
+        glob->pieces = &filter->pieces[piece_count];
+        glob->has_star = strchr(pattern, '*') != NULL;
+        glob->anchored_start = pattern[0] != '*';
+        glob->anchored_end = pattern[length - 1] != '*';
+        for (char *text = pattern; *text != '\0';)
+        {
+            size_t literal = strcspn(text, "*");
+            if (literal > 0)
+            {
+                filter->pieces[piece_count].text = text;
+                filter->pieces[piece_count].length = literal;
+                filter->pieces[piece_count].has_any = memchr(text, '?', literal) != NULL;
+                piece_count++;
+                glob->piece_count++;
+            }
+            text += literal;
+            while (*text == '*')
+                *text++ = '\0';
+        }
+        filter->positive_count += glob->negative ? 0 : 1;
+        filter->glob_count++;
+    }
+    return true;
+}
+
+bool ctest__match_filter(const ctest__filter_t *filter, const char *name)
+{
+    size_t length = strlen(name);
+    bool selected = filter->positive_count == 0;
+    for (int i = 0; i < filter->glob_count; i++)
+    {
+        // Once selected, only the exclusions are left to check
+        const ctest__glob_t *glob = &filter->globs[i];
+        if ((glob->negative || !selected) && ctest__match_glob(glob, name, length))
+        {
+            if (glob->negative)
+                return false;
+            selected = true;
+        }
+    }
+    return selected;
+}
+
+void ctest__free_filter(ctest__filter_t *filter)
+{
+    free(filter->storage);
+    free(filter->globs);
+    free(filter->pieces);
+    memset(filter, 0, sizeof(*filter));
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static bool ctest__match_glob(const ctest__glob_t *glob, const char *name, size_t length)
+{
+    if (glob->piece_count == 0)
+        return true;
+    const ctest__glob_piece_t *first = &glob->pieces[0];
+    const ctest__glob_piece_t *last = &glob->pieces[glob->piece_count - 1];
+    if (!glob->has_star)
+        return length == first->length && ctest__match_piece(first, name);
+
+    // Anchored ends are checked first, they are the cheapest way to reject a name
+    const char *begin = name;
+    const char *end = name + length;
+    int from = 0;
+    int to = glob->piece_count;
+    if (glob->anchored_start)
+    {
+        if (length < first->length || !ctest__match_piece(first, name))
+            return false;
+        begin += first->length;
+        from++;
+    }
+    if (glob->anchored_end && to > from)
+    {
+        if ((size_t)(end - begin) < last->length || !ctest__match_piece(last, end - last->length))
+            return false;
+        end -= last->length;
+        to--;
+    }
+
+    // Pieces between stars match leftmost, which never rules out a match of the pieces that follow
+    for (int i = from; i < to; i++)
+    {
+        begin = ctest__find_piece(&glob->pieces[i], begin, end);
+        if (begin == NULL)
+            return false;
+        begin += glob->pieces[i].length;
+    }
+    return true;
+}
+
+static bool ctest__match_piece(const ctest__glob_piece_t *piece, const char *text)
+{
+    if (!piece->has_any)
+        return memcmp(piece->text, text, piece->length) == 0;
+    for (size_t i = 0; i < piece->length; i++)
+    {
+        if (piece->text[i] != '?' && piece->text[i] != text[i])
+            return false;
+    }
+    return true;
+}
+
+static const char *ctest__find_piece(const ctest__glob_piece_t *piece, const char *text, const char *end)
+{
+    for (; (size_t)(end - text) >= piece->length; text++)
+    {
+        if ((piece->has_any || *text == piece->text[0]) && ctest__match_piece(piece, text))
+            return text;
+    }
+    return NULL;
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,202 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_fixture.c
+ * @brief       Setup and teardown of the fixtures used by tests, shared fixtures are set up once per run.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Setup state of a shared fixture.
+ */
+typedef enum
+{
+    CTEST__FIXTURE_IDLE = 0,   // Not set up
+    CTEST__FIXTURE_SETTING_UP, // Being set up by a test, others wait for it
+    CTEST__FIXTURE_READY,      // Set up and in use
+    CTEST__FIXTURE_FAILED,     // Setup failed, not retried during the run
+} ctest__fixture_state_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static void *ctest__setup_fixture(ctest__fixture_t *fixture, int *failed_assertions);
+static int ctest__teardown_fixture(ctest__fixture_t *fixture, void *data);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Guards the state of all shared fixtures, setups and teardowns run without holding it.
+ */
+static pthread_mutex_t ctest__fixture_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief   Signaled when the setup of a shared fixture finishes.
+ */
+static pthread_cond_t ctest__fixture_ready = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief   Per-test fixture instance the running test of the calling thread has not released yet, NULL when none.
+ */
+static __thread ctest__fixture_t *ctest__live_fixture;
+static __thread void *ctest__live_data;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+void *ctest__acquire_fixture(ctest__fixture_t *fixture, const char *file, const char *test_name, int line,
+                             int *failed_assertions)
+{
+    if (!fixture->shared)
+    {
+        void *data = ctest__setup_fixture(fixture, failed_assertions);
+        ctest__live_fixture = data != NULL ? fixture : NULL;
+        ctest__live_data = data;
+        return data;
+    }
+
+    // First test to get here sets the fixture up, tests running in parallel wait for it instead of setting up their own
+    pthread_mutex_lock(&ctest__fixture_lock);
+    while (fixture->state == CTEST__FIXTURE_SETTING_UP)
+        pthread_cond_wait(&ctest__fixture_ready, &ctest__fixture_lock);
+    if (fixture->state == CTEST__FIXTURE_IDLE)
+    {
+        fixture->state = CTEST__FIXTURE_SETTING_UP;
+        pthread_mutex_unlock(&ctest__fixture_lock);
+        // Shared instance outlives the test setting it up, its allocations are not counted against that test
+        ctest__pause_heap_tracking();
+        void *data = ctest__setup_fixture(fixture, failed_assertions);
+        ctest__resume_heap_tracking();
+        pthread_mutex_lock(&ctest__fixture_lock);
+        fixture->data = data;
+        fixture->state = data != NULL ? CTEST__FIXTURE_READY : CTEST__FIXTURE_FAILED;
+        pthread_cond_broadcast(&ctest__fixture_ready);
+        pthread_mutex_unlock(&ctest__fixture_lock);
+        return data;
+    }
+    void *data = fixture->state == CTEST__FIXTURE_READY ? fixture->data : NULL;
+    pthread_mutex_unlock(&ctest__fixture_lock);
+
+    if (data == NULL)
+    {
+        ctest__fail(fixture->name, file, test_name, line, "Setup of shared fixture %s failed", fixture->name);
+        (*failed_assertions)++;
+    }
+    return data;
+}
+
+int ctest__release_fixture(ctest__fixture_t *fixture, void *data)
+{
+    if (!fixture->shared)
+    {
+        ctest__live_fixture = NULL;
+        ctest__live_data = NULL;
+        return ctest__teardown_fixture(fixture, data);
+    }
+
+    // Last test of the run using the fixture tears it down, a later user would set it up again
+    pthread_mutex_lock(&ctest__fixture_lock);
+    bool last = --fixture->users == 0;
+    if (last)
+    {
+        fixture->data = NULL;
+        fixture->state = CTEST__FIXTURE_IDLE;
+    }
+    pthread_mutex_unlock(&ctest__fixture_lock);
+    return last ? ctest__teardown_fixture(fixture, data) : 0;
+}
+
+void ctest__prepare_fixtures(const ctest__run_t *run)
+{
+    for (int i = 0; i < run->test_count; i++)
+    {
+        if (run->tests[i].fixture != NULL)
+            run->tests[i].fixture->users = 0;
+    }
+    // Cached tests do not run, a shared fixture used only by them is never set up
+    for (int i = 0; i < run->test_count; i++)
+    {
+        if (run->tests[i].fixture != NULL && !run->results[i].cached)
+            run->tests[i].fixture->users++;
+    }
+}
+
+int ctest__release_test_fixture(void)
+{
+    // Test returned early or timed out before its release, its own instance would otherwise never be torn down
+    ctest__fixture_t *fixture = ctest__live_fixture;
+    if (fixture == NULL)
+        return 0;
+    void *data = ctest__live_data;
+    ctest__live_fixture = NULL;
+    ctest__live_data = NULL;
+    return ctest__teardown_fixture(fixture, data);
+}
+
+void ctest__teardown_fixtures(const ctest__test_t *tests, int test_count)
+{
+    // Suite fixtures still held by tests that timed out or returned early, or set up by a worker process, are torn
+    // down here
+    for (int i = 0; i < test_count; i++)
+    {
+        ctest__fixture_t *fixture = tests[i].fixture;
+        if (fixture == NULL || fixture->state != CTEST__FIXTURE_READY)
+            continue;
+        void *data = fixture->data;
+        fixture->data = NULL;
+        fixture->state = CTEST__FIXTURE_IDLE;
+        if (ctest__teardown_fixture(fixture, data) > 0)
+            ctest__print("💥 Teardown of fixture " CTEST_GRYB "%s" CTEST_GRY " failed!\n", fixture->name);
+        ctest__flush_output();
+    }
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static void *ctest__setup_fixture(ctest__fixture_t *fixture, int *failed_assertions)
+{
+    ctest__pause_heap_tracking();
+    void *data = calloc(1, fixture->size > 0 ? fixture->size : 1);
+    ctest__resume_heap_tracking();
+    if (data == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not allocate memory for fixture %s!\n", fixture->name);
+        exit(1);
+    }
+
+    // Teardown sees the partially set up instance, it starts zeroed so teardown can tell what to release
+    uint64_t start_ns = ctest__get_time_ns();
+    int failed = fixture->setup(data);
+    ctest__trace_fixture(fixture->name, "setup", start_ns);
+    if (failed > 0)
+    {
+        *failed_assertions += failed + ctest__teardown_fixture(fixture, data);
+        return NULL;
+    }
+    return data;
+}
+
+static int ctest__teardown_fixture(ctest__fixture_t *fixture, void *data)
+{
+    uint64_t start_ns = ctest__get_time_ns();
+    int failed = fixture->teardown(data);
+    ctest__trace_fixture(fixture->name, "teardown", start_ns);
+    free(data);
+    return failed;
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,533 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_float.c
+ * @brief       Vectorized tolerance checks of floating point arrays and the report of values out of tolerance.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Vector checks need SSE2, which every x86-64 CPU has, AVX2 is picked at run time when the CPU supports it
+#if (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))) && (defined(__GNUC__) || defined(__clang__))
+#define CTEST__HAS_SSE2 1
+#include <immintrin.h>
+#else
+#define CTEST__HAS_SSE2 0
+#endif // Vector checks
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Implementations of the search for the first pair of values out of tolerance.
+ */
+typedef size_t (*ctest__find_not_near_float_fn_t)(const float *a, const float *b, size_t count,
+                                                  ctest__tolerance_t tolerance);
+typedef size_t (*ctest__find_not_near_double_fn_t)(const double *a, const double *b, size_t count,
+                                                   ctest__tolerance_t tolerance);
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static size_t ctest__find_not_near_float_scalar(const float *a, const float *b, size_t count,
+                                                ctest__tolerance_t tolerance);
+static size_t ctest__find_not_near_double_scalar(const double *a, const double *b, size_t count,
+                                                 ctest__tolerance_t tolerance);
+#if CTEST__HAS_SSE2
+static size_t ctest__find_not_near_float_sse2(const float *a, const float *b, size_t count,
+                                              ctest__tolerance_t tolerance);
+static size_t ctest__find_not_near_double_sse2(const double *a, const double *b, size_t count,
+                                               ctest__tolerance_t tolerance);
+static size_t ctest__find_not_near_float_avx2(const float *a, const float *b, size_t count,
+                                              ctest__tolerance_t tolerance);
+static size_t ctest__find_not_near_double_avx2(const double *a, const double *b, size_t count,
+                                               ctest__tolerance_t tolerance);
+#endif // CTEST__HAS_SSE2
+static void ctest__select_find_not_near(void);
+static double ctest__get_error(double a, double b, bool single, ctest__tolerance_t tolerance);
+static const char *ctest__format_real(double value, bool single, char *buffer, size_t size);
+static void ctest__add_tolerance(ctest__failure_t *failure, double a, double b, bool single,
+                                 ctest__tolerance_t tolerance);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Implementations picked for the CPU on first use, NULL until then.
+ */
+static ctest__find_not_near_float_fn_t ctest__find_not_near_float_impl;
+static ctest__find_not_near_double_fn_t ctest__find_not_near_double_impl;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+size_t ctest__find_not_near_float(const float *a, const float *b, size_t count, ctest__tolerance_t tolerance)
+{
+    if (count == 0)
+        return count;
+    if (a == NULL || b == NULL)
+        return 0;
+
+    // Racing threads all pick the same implementation, so a relaxed store is enough
+    ctest__find_not_near_float_fn_t find = __atomic_load_n(&ctest__find_not_near_float_impl, __ATOMIC_RELAXED);
+    if (find == NULL)
+    {
+        ctest__select_find_not_near();
+        find = __atomic_load_n(&ctest__find_not_near_float_impl, __ATOMIC_RELAXED);
+    }
+    return find(a, b, count, tolerance);
+}
+
+size_t ctest__find_not_near_double(const double *a, const double *b, size_t count, ctest__tolerance_t tolerance)
+{
+    if (count == 0)
+        return count;
+    if (a == NULL || b == NULL)
+        return 0;
+
+    ctest__find_not_near_double_fn_t find = __atomic_load_n(&ctest__find_not_near_double_impl, __ATOMIC_RELAXED);
+    if (find == NULL)
+    {
+        ctest__select_find_not_near();
+        find = __atomic_load_n(&ctest__find_not_near_double_impl, __ATOMIC_RELAXED);
+    }
+    return find(a, b, count, tolerance);
+}
+
+void ctest__fail_near(const char *expression, const char *left_text, const char *right_text, double left,
+                      double right, bool single, ctest__tolerance_t tolerance, const char *file, const char *test_name,
+                      int line, const char *msg, ...)
+{
+    char left_value[64];
+    char right_value[64];
+    ctest__failure_t *failure = ctest__begin_failure(expression, file, test_name, line);
+    ctest__add_failure_operand(failure, left_text, ctest__format_real(left, single, left_value, sizeof(left_value)),
+                               false);
+    ctest__add_failure_operand(failure, right_text,
+                               ctest__format_real(right, single, right_value, sizeof(right_value)), false);
+    ctest__add_tolerance(failure, left, right, single, tolerance);
+
+    va_list args;
+    va_start(args, msg);
+    ctest__end_failure(failure, msg, args);
+    va_end(args);
+}
+
+void ctest__fail_near_array(const char *expression, const char *left_text, const char *right_text, const void *left,
+                            const void *right, bool single, size_t count, size_t first, ctest__tolerance_t tolerance,
+                            const char *file, const char *test_name, int line, const char *msg, ...)
+{
+    ctest__failure_t *failure = ctest__begin_failure(expression, file, test_name, line);
+    if (left == NULL || right == NULL)
+    {
+        ctest__add_failure_value(failure, "%s is NULL, %zu elements compared", left == NULL ? left_text : right_text,
+                                 count);
+    }
+    else
+    {
+        // Failing path only, so the statistics are gathered by a plain loop starting at the first value out of range
+        size_t failed = 0;
+        size_t worst = first;
+        double worst_error = -1.0;
+        for (size_t i = first; i < count; i++)
+        {
+            double a = single ? (double)((const float *)left)[i] : ((const double *)left)[i];
+            double b = single ? (double)((const float *)right)[i] : ((const double *)right)[i];
+            bool near = single ? ctest__near_float((float)a, (float)b, tolerance) : ctest__near_double(a, b, tolerance);
+            if (near)
+                continue;
+            double error = ctest__get_error(a, b, single, tolerance);
+            failed++;
+            // NaN is worse than any error, the first one found is kept
+            if (worst_error == worst_error && (error != error || error > worst_error))
+            {
+                worst = i;
+                worst_error = error;
+            }
+        }
+
+        char a_value[64];
+        char b_value[64];
+        double a = 0.0;
+        double b = 0.0;
+        ctest__add_failure_value(failure, "%zu of %zu elements out of tolerance", failed, count);
+        for (int pass = 0; pass < (worst != first ? 2 : 1); pass++)
+        {
+            size_t index = pass == 0 ? first : worst;
+            const char *label = pass == 1 ? "Worst" : (worst == first ? "First and worst" : "First");
+            a = single ? (double)((const float *)left)[index] : ((const double *)left)[index];
+            b = single ? (double)((const float *)right)[index] : ((const double *)right)[index];
+            ctest__add_failure_value(failure, "%s at %zu: %s[%zu] = %s, %s[%zu] = %s", label, index, left_text, index,
+                                     ctest__format_real(a, single, a_value, sizeof(a_value)), right_text, index,
+                                     ctest__format_real(b, single, b_value, sizeof(b_value)));
+        }
+        // Last pair reported is the worst one
+        ctest__add_tolerance(failure, a, b, single, tolerance);
+    }
+
+    va_list args;
+    va_start(args, msg);
+    ctest__end_failure(failure, msg, args);
+    va_end(args);
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static size_t ctest__find_not_near_float_scalar(const float *a, const float *b, size_t count,
+                                                ctest__tolerance_t tolerance)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!ctest__near_float(a[i], b[i], tolerance))
+            return i;
+    }
+    return count;
+}
+
+static size_t ctest__find_not_near_double_scalar(const double *a, const double *b, size_t count,
+                                                 ctest__tolerance_t tolerance)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!ctest__near_double(a[i], b[i], tolerance))
+            return i;
+    }
+    return count;
+}
+
+#if CTEST__HAS_SSE2
+// The vector loops only find the block holding the first value out of tolerance, the scalar check of the header
+// pinpoints it. Absolute and relative tolerance share a loop, the bound is absolute + relative * max(|a|, |b|) with
+// the unused term zero. Equal values always pass and NaN never does, as in the scalar check. Lanes holding an infinity
+// are out of tolerance unless both values are equal, an infinite magnitude would otherwise meet an infinite bound.
+
+static inline __m128 ctest__near_ps(__m128 x, __m128 y, __m128 absolute, __m128 relative)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 difference = _mm_andnot_ps(sign, _mm_sub_ps(x, y));
+    __m128 magnitude = _mm_max_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y));
+    __m128 bound = _mm_add_ps(absolute, _mm_mul_ps(relative, magnitude));
+    __m128 finite = _mm_cmplt_ps(magnitude, _mm_set1_ps(__builtin_inff()));
+    return _mm_or_ps(_mm_cmpeq_ps(x, y), _mm_and_ps(_mm_cmple_ps(difference, bound), finite));
+}
+
+static inline __m128i ctest__far_ulps_ps(__m128 x, __m128 y, __m128i limit)
+{
+    // Ordering the bit patterns as integers makes adjacent floats differ by one, the distance fits 32 bits unsigned
+    __m128i ix = _mm_castps_si128(x);
+    __m128i iy = _mm_castps_si128(y);
+    __m128i sx = _mm_srai_epi32(ix, 31);
+    __m128i sy = _mm_srai_epi32(iy, 31);
+    __m128i ox = _mm_sub_epi32(_mm_xor_si128(ix, _mm_srli_epi32(sx, 1)), sx);
+    __m128i oy = _mm_sub_epi32(_mm_xor_si128(iy, _mm_srli_epi32(sy, 1)), sy);
+    __m128i greater = _mm_cmpgt_epi32(ox, oy);
+    __m128i distance = _mm_or_si128(_mm_and_si128(greater, _mm_sub_epi32(ox, oy)),
+                                    _mm_andnot_si128(greater, _mm_sub_epi32(oy, ox)));
+    __m128i far = _mm_cmpgt_epi32(_mm_xor_si128(distance, _mm_set1_epi32(INT32_MIN)), limit);
+    // Largest finite value is a single ULP from infinity, unequal values where either is not finite are always far
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 magnitude = _mm_max_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y));
+    __m128 infinite = _mm_and_ps(_mm_cmpneq_ps(x, y), _mm_cmpnlt_ps(magnitude, _mm_set1_ps(__builtin_inff())));
+    return _mm_or_si128(far, _mm_castps_si128(_mm_or_ps(_mm_cmpunord_ps(x, y), infinite)));
+}
+
+static size_t ctest__find_not_near_float_sse2(const float *a, const float *b, size_t count,
+                                              ctest__tolerance_t tolerance)
+{
+    size_t i = 0;
+    if (tolerance.kind == CTEST__TOLERANCE_ULP)
+    {
+        uint32_t ulps = tolerance.ulps < UINT32_MAX ? (uint32_t)tolerance.ulps : UINT32_MAX;
+        const __m128i limit = _mm_set1_epi32((int32_t)(ulps ^ 0x80000000u));
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i far0 = ctest__far_ulps_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i]), limit);
+            __m128i far1 = ctest__far_ulps_ps(_mm_loadu_ps(&a[i + 4]), _mm_loadu_ps(&b[i + 4]), limit);
+            __m128i far2 = ctest__far_ulps_ps(_mm_loadu_ps(&a[i + 8]), _mm_loadu_ps(&b[i + 8]), limit);
+            __m128i far3 = ctest__far_ulps_ps(_mm_loadu_ps(&a[i + 12]), _mm_loadu_ps(&b[i + 12]), limit);
+            if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(far0, far1), _mm_or_si128(far2, far3))) != 0)
+                break;
+        }
+    }
+    else
+    {
+        bool absolute = tolerance.kind == CTEST__TOLERANCE_ABS;
+        const __m128 abs_bound = _mm_set1_ps(absolute ? (float)tolerance.value : 0.0f);
+        const __m128 rel_bound = _mm_set1_ps(absolute ? 0.0f : (float)tolerance.value);
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128 near0 = ctest__near_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i]), abs_bound, rel_bound);
+            __m128 near1 = ctest__near_ps(_mm_loadu_ps(&a[i + 4]), _mm_loadu_ps(&b[i + 4]), abs_bound, rel_bound);
+            __m128 near2 = ctest__near_ps(_mm_loadu_ps(&a[i + 8]), _mm_loadu_ps(&b[i + 8]), abs_bound, rel_bound);
+            __m128 near3 = ctest__near_ps(_mm_loadu_ps(&a[i + 12]), _mm_loadu_ps(&b[i + 12]), abs_bound, rel_bound);
+            if (_mm_movemask_ps(_mm_and_ps(_mm_and_ps(near0, near1), _mm_and_ps(near2, near3))) != 0xf)
+                break;
+        }
+    }
+    return i + ctest__find_not_near_float_scalar(&a[i], &b[i], count - i, tolerance);
+}
+
+static inline __m128d ctest__near_pd(__m128d x, __m128d y, __m128d absolute, __m128d relative)
+{
+    const __m128d sign = _mm_set1_pd(-0.0);
+    __m128d difference = _mm_andnot_pd(sign, _mm_sub_pd(x, y));
+    __m128d magnitude = _mm_max_pd(_mm_andnot_pd(sign, x), _mm_andnot_pd(sign, y));
+    __m128d bound = _mm_add_pd(absolute, _mm_mul_pd(relative, magnitude));
+    __m128d finite = _mm_cmplt_pd(magnitude, _mm_set1_pd(__builtin_inf()));
+    return _mm_or_pd(_mm_cmpeq_pd(x, y), _mm_and_pd(_mm_cmple_pd(difference, bound), finite));
+}
+
+static size_t ctest__find_not_near_double_sse2(const double *a, const double *b, size_t count,
+                                               ctest__tolerance_t tolerance)
+{
+    // SSE2 has no 64-bit integer compare, the distance in ULPs is measured by the scalar check
+    if (tolerance.kind == CTEST__TOLERANCE_ULP)
+        return ctest__find_not_near_double_scalar(a, b, count, tolerance);
+
+    size_t i = 0;
+    bool absolute = tolerance.kind == CTEST__TOLERANCE_ABS;
+    const __m128d abs_bound = _mm_set1_pd(absolute ? tolerance.value : 0.0);
+    const __m128d rel_bound = _mm_set1_pd(absolute ? 0.0 : tolerance.value);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128d near0 = ctest__near_pd(_mm_loadu_pd(&a[i]), _mm_loadu_pd(&b[i]), abs_bound, rel_bound);
+        __m128d near1 = ctest__near_pd(_mm_loadu_pd(&a[i + 2]), _mm_loadu_pd(&b[i + 2]), abs_bound, rel_bound);
+        __m128d near2 = ctest__near_pd(_mm_loadu_pd(&a[i + 4]), _mm_loadu_pd(&b[i + 4]), abs_bound, rel_bound);
+        __m128d near3 = ctest__near_pd(_mm_loadu_pd(&a[i + 6]), _mm_loadu_pd(&b[i + 6]), abs_bound, rel_bound);
+        if (_mm_movemask_pd(_mm_and_pd(_mm_and_pd(near0, near1), _mm_and_pd(near2, near3))) != 0x3)
+            break;
+    }
+    return i + ctest__find_not_near_double_scalar(&a[i], &b[i], count - i, tolerance);
+}
+
+__attribute__((target("avx2"))) static inline __m256 ctest__near_ps256(__m256 x, __m256 y, __m256 absolute,
+                                                                       __m256 relative)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 difference = _mm256_andnot_ps(sign, _mm256_sub_ps(x, y));
+    __m256 magnitude = _mm256_max_ps(_mm256_andnot_ps(sign, x), _mm256_andnot_ps(sign, y));
+    __m256 bound = _mm256_add_ps(absolute, _mm256_mul_ps(relative, magnitude));
+    __m256 finite = _mm256_cmp_ps(magnitude, _mm256_set1_ps(__builtin_inff()), _CMP_LT_OQ);
+    return _mm256_or_ps(_mm256_cmp_ps(x, y, _CMP_EQ_OQ),
+                        _mm256_and_ps(_mm256_cmp_ps(difference, bound, _CMP_LE_OQ), finite));
+}
+
+__attribute__((target("avx2"))) static inline __m256i ctest__far_ulps_ps256(__m256 x, __m256 y, __m256i limit)
+{
+    __m256i ix = _mm256_castps_si256(x);
+    __m256i iy = _mm256_castps_si256(y);
+    __m256i sx = _mm256_srai_epi32(ix, 31);
+    __m256i sy = _mm256_srai_epi32(iy, 31);
+    __m256i ox = _mm256_sub_epi32(_mm256_xor_si256(ix, _mm256_srli_epi32(sx, 1)), sx);
+    __m256i oy = _mm256_sub_epi32(_mm256_xor_si256(iy, _mm256_srli_epi32(sy, 1)), sy);
+    __m256i greater = _mm256_cmpgt_epi32(ox, oy);
+    __m256i distance = _mm256_blendv_epi8(_mm256_sub_epi32(oy, ox), _mm256_sub_epi32(ox, oy), greater);
+    __m256i far = _mm256_cmpgt_epi32(_mm256_xor_si256(distance, _mm256_set1_epi32(INT32_MIN)), limit);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 magnitude = _mm256_max_ps(_mm256_andnot_ps(sign, x), _mm256_andnot_ps(sign, y));
+    __m256 infinite = _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_NEQ_UQ),
+                                    _mm256_cmp_ps(magnitude, _mm256_set1_ps(__builtin_inff()), _CMP_NLT_UQ));
+    return _mm256_or_si256(far, _mm256_castps_si256(_mm256_or_ps(_mm256_cmp_ps(x, y, _CMP_UNORD_Q), infinite)));
+}
+
+__attribute__((target("avx2"))) static size_t ctest__find_not_near_float_avx2(const float *a, const float *b,
+                                                                              size_t count,
+                                                                              ctest__tolerance_t tolerance)
+{
+    size_t i = 0;
+    if (tolerance.kind == CTEST__TOLERANCE_ULP)
+    {
+        uint32_t ulps = tolerance.ulps < UINT32_MAX ? (uint32_t)tolerance.ulps : UINT32_MAX;
+        const __m256i limit = _mm256_set1_epi32((int32_t)(ulps ^ 0x80000000u));
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i far0 = ctest__far_ulps_ps256(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), limit);
+            __m256i far1 = ctest__far_ulps_ps256(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8]), limit);
+            __m256i far2 = ctest__far_ulps_ps256(_mm256_loadu_ps(&a[i + 16]), _mm256_loadu_ps(&b[i + 16]), limit);
+            __m256i far3 = ctest__far_ulps_ps256(_mm256_loadu_ps(&a[i + 24]), _mm256_loadu_ps(&b[i + 24]), limit);
+            if (!_mm256_testz_si256(_mm256_or_si256(far0, far1), _mm256_set1_epi8(-1)) ||
+                !_mm256_testz_si256(_mm256_or_si256(far2, far3), _mm256_set1_epi8(-1)))
+                break;
+        }
+    }
+    else
+    {
+        bool absolute = tolerance.kind == CTEST__TOLERANCE_ABS;
+        const __m256 abs_bound = _mm256_set1_ps(absolute ? (float)tolerance.value : 0.0f);
+        const __m256 rel_bound = _mm256_set1_ps(absolute ? 0.0f : (float)tolerance.value);
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256 near0 = ctest__near_ps256(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), abs_bound, rel_bound);
+            __m256 near1 =
+                ctest__near_ps256(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8]), abs_bound, rel_bound);
+            __m256 near2 =
+                ctest__near_ps256(_mm256_loadu_ps(&a[i + 16]), _mm256_loadu_ps(&b[i + 16]), abs_bound, rel_bound);
+            __m256 near3 =
+                ctest__near_ps256(_mm256_loadu_ps(&a[i + 24]), _mm256_loadu_ps(&b[i + 24]), abs_bound, rel_bound);
+            if (_mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(near0, near1), _mm256_and_ps(near2, near3))) != 0xff)
+                break;
+        }
+    }
+    return i + ctest__find_not_near_float_sse2(&a[i], &b[i], count - i, tolerance);
+}
+
+__attribute__((target("avx2"))) static inline __m256d ctest__near_pd256(__m256d x, __m256d y, __m256d absolute,
+                                                                        __m256d relative)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d difference = _mm256_andnot_pd(sign, _mm256_sub_pd(x, y));
+    __m256d magnitude = _mm256_max_pd(_mm256_andnot_pd(sign, x), _mm256_andnot_pd(sign, y));
+    __m256d bound = _mm256_add_pd(absolute, _mm256_mul_pd(relative, magnitude));
+    __m256d finite = _mm256_cmp_pd(magnitude, _mm256_set1_pd(__builtin_inf()), _CMP_LT_OQ);
+    return _mm256_or_pd(_mm256_cmp_pd(x, y, _CMP_EQ_OQ),
+                        _mm256_and_pd(_mm256_cmp_pd(difference, bound, _CMP_LE_OQ), finite));
+}
+
+__attribute__((target("avx2"))) static inline __m256i ctest__far_ulps_pd256(__m256d x, __m256d y, __m256i limit)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i ix = _mm256_castpd_si256(x);
+    __m256i iy = _mm256_castpd_si256(y);
+    __m256i sx = _mm256_cmpgt_epi64(zero, ix);
+    __m256i sy = _mm256_cmpgt_epi64(zero, iy);
+    __m256i ox = _mm256_sub_epi64(_mm256_xor_si256(ix, _mm256_srli_epi64(sx, 1)), sx);
+    __m256i oy = _mm256_sub_epi64(_mm256_xor_si256(iy, _mm256_srli_epi64(sy, 1)), sy);
+    __m256i greater = _mm256_cmpgt_epi64(ox, oy);
+    __m256i distance = _mm256_blendv_epi8(_mm256_sub_epi64(oy, ox), _mm256_sub_epi64(ox, oy), greater);
+    __m256i far = _mm256_cmpgt_epi64(_mm256_xor_si256(distance, _mm256_set1_epi64x(INT64_MIN)), limit);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d magnitude = _mm256_max_pd(_mm256_andnot_pd(sign, x), _mm256_andnot_pd(sign, y));
+    __m256d infinite = _mm256_and_pd(_mm256_cmp_pd(x, y, _CMP_NEQ_UQ),
+                                     _mm256_cmp_pd(magnitude, _mm256_set1_pd(__builtin_inf()), _CMP_NLT_UQ));
+    return _mm256_or_si256(far, _mm256_castpd_si256(_mm256_or_pd(_mm256_cmp_pd(x, y, _CMP_UNORD_Q), infinite)));
+}
+
+__attribute__((target("avx2"))) static size_t ctest__find_not_near_double_avx2(const double *a, const double *b,
+                                                                               size_t count,
+                                                                               ctest__tolerance_t tolerance)
+{
+    size_t i = 0;
+    if (tolerance.kind == CTEST__TOLERANCE_ULP)
+    {
+        const __m256i limit = _mm256_set1_epi64x((int64_t)(tolerance.ulps ^ 0x8000000000000000u));
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i far0 = ctest__far_ulps_pd256(_mm256_loadu_pd(&a[i]), _mm256_loadu_pd(&b[i]), limit);
+            __m256i far1 = ctest__far_ulps_pd256(_mm256_loadu_pd(&a[i + 4]), _mm256_loadu_pd(&b[i + 4]), limit);
+            __m256i far2 = ctest__far_ulps_pd256(_mm256_loadu_pd(&a[i + 8]), _mm256_loadu_pd(&b[i + 8]), limit);
+            __m256i far3 = ctest__far_ulps_pd256(_mm256_loadu_pd(&a[i + 12]), _mm256_loadu_pd(&b[i + 12]), limit);
+            if (!_mm256_testz_si256(_mm256_or_si256(far0, far1), _mm256_set1_epi8(-1)) ||
+                !_mm256_testz_si256(_mm256_or_si256(far2, far3), _mm256_set1_epi8(-1)))
+                break;
+        }
+        return i + ctest__find_not_near_double_scalar(&a[i], &b[i], count - i, tolerance);
+    }
+
+    bool absolute = tolerance.kind == CTEST__TOLERANCE_ABS;
+    const __m256d abs_bound = _mm256_set1_pd(absolute ? tolerance.value : 0.0);
+    const __m256d rel_bound = _mm256_set1_pd(absolute ? 0.0 : tolerance.value);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256d near0 = ctest__near_pd256(_mm256_loadu_pd(&a[i]), _mm256_loadu_pd(&b[i]), abs_bound, rel_bound);
+        __m256d near1 =
+            ctest__near_pd256(_mm256_loadu_pd(&a[i + 4]), _mm256_loadu_pd(&b[i + 4]), abs_bound, rel_bound);
+        __m256d near2 =
+            ctest__near_pd256(_mm256_loadu_pd(&a[i + 8]), _mm256_loadu_pd(&b[i + 8]), abs_bound, rel_bound);
+        __m256d near3 =
+            ctest__near_pd256(_mm256_loadu_pd(&a[i + 12]), _mm256_loadu_pd(&b[i + 12]), abs_bound, rel_bound);
+        if (_mm256_movemask_pd(_mm256_and_pd(_mm256_and_pd(near0, near1), _mm256_and_pd(near2, near3))) != 0xf)
+            break;
+    }
+    return i + ctest__find_not_near_double_sse2(&a[i], &b[i], count - i, tolerance);
+}
+#endif // CTEST__HAS_SSE2
+
+static void ctest__select_find_not_near(void)
+{
+    ctest__find_not_near_float_fn_t find_float = ctest__find_not_near_float_scalar;
+    ctest__find_not_near_double_fn_t find_double = ctest__find_not_near_double_scalar;
+#if CTEST__HAS_SSE2
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    find_float = avx2 ? ctest__find_not_near_float_avx2 : ctest__find_not_near_float_sse2;
+    find_double = avx2 ? ctest__find_not_near_double_avx2 : ctest__find_not_near_double_sse2;
+#endif // CTEST__HAS_SSE2
+    __atomic_store_n(&ctest__find_not_near_float_impl, find_float, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctest__find_not_near_double_impl, find_double, __ATOMIC_RELAXED);
+}
+
+static double ctest__get_error(double a, double b, bool single, ctest__tolerance_t tolerance)
+{
+    if (a != a || b != b)
+        return a + b; // NaN
+    if (a == b)
+        return 0.0;
+    if (!__builtin_isfinite(a) || !__builtin_isfinite(b))
+        return __builtin_inf();
+    if (tolerance.kind == CTEST__TOLERANCE_ULP)
+        return (double)(single ? ctest__ulps_float((float)a, (float)b) : ctest__ulps_double(a, b));
+
+    double difference = a > b ? a - b : b - a;
+    if (tolerance.kind == CTEST__TOLERANCE_ABS)
+        return difference;
+    double magnitude_a = a < 0 ? -a : a;
+    double magnitude_b = b < 0 ? -b : b;
+    return difference / (magnitude_a > magnitude_b ? magnitude_a : magnitude_b);
+}
+
+static const char *ctest__format_real(double value, bool single, char *buffer, size_t size)
+{
+    // Shortest precision that reads back as the same value, so values differing in the last bit look different
+    for (int precision = single ? 6 : 15; precision <= (single ? 9 : 17); precision++)
+    {
+        snprintf(buffer, size, "%.*g", precision, value);
+        double parsed = strtod(buffer, NULL);
+        if (single ? (float)parsed == (float)value : parsed == value)
+            break;
+    }
+    return buffer;
+}
+
+static void ctest__add_tolerance(ctest__failure_t *failure, double a, double b, bool single,
+                                 ctest__tolerance_t tolerance)
+{
+    char error_value[64];
+    char bound_value[64];
+    double error = ctest__get_error(a, b, single, tolerance);
+    if (error != error)
+    {
+        ctest__add_failure_value(failure, "NaN is never near any value");
+    }
+    else if (!__builtin_isfinite(a) && !__builtin_isfinite(b))
+    {
+        ctest__add_failure_value(failure, "Infinities of opposite sign are never near");
+    }
+    else if (!__builtin_isfinite(a) || !__builtin_isfinite(b))
+    {
+        ctest__add_failure_value(failure, "Infinity is never near a finite value");
+    }
+    else if (tolerance.kind == CTEST__TOLERANCE_ULP)
+    {
+        ctest__add_failure_value(failure, "%.0f ULPs apart, tolerance %llu ULPs", error,
+                                 (unsigned long long)tolerance.ulps);
+    }
+    else
+    {
+        ctest__add_failure_value(failure, "%s difference %s exceeds tolerance %s",
+                                 tolerance.kind == CTEST__TOLERANCE_ABS ? "Absolute" : "Relative",
+                                 ctest__format_real(error, single, error_value, sizeof(error_value)),
+                                 ctest__format_real(tolerance.value, false, bound_value, sizeof(bound_value)));
+    }
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
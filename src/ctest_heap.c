@@ -0,0 +1,521 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_heap.c
+ * @brief       Heap allocations counted per test and the allocations a test leaked, fed by the wrapped allocator or the
+ *              ESP-IDF heap hooks.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Wrapped allocator knows the size of a freed block only where the C library can tell it
+#if defined(CTEST_WRAP_MALLOC) && defined(__has_include)
+#if __has_include(<malloc.h>)
+#include <malloc.h>
+#define CTEST__HAS_USABLE_SIZE 1
+#endif // __has_include(<malloc.h>)
+#endif // CTEST_WRAP_MALLOC
+#ifndef CTEST__HAS_USABLE_SIZE
+#define CTEST__HAS_USABLE_SIZE 0
+#endif // CTEST__HAS_USABLE_SIZE
+
+// ESP-IDF reports every allocation to the heap hooks when they are enabled in the configuration
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#if defined(CONFIG_HEAP_USE_HOOKS)
+#include "esp_heap_caps.h"
+#define CTEST__HAS_HEAP_HOOKS 1
+#endif // CONFIG_HEAP_USE_HOOKS
+#endif // ESP_PLATFORM
+#ifndef CTEST__HAS_HEAP_HOOKS
+#define CTEST__HAS_HEAP_HOOKS 0
+#endif // CTEST__HAS_HEAP_HOOKS
+
+// Allocation sites are resolved to symbols with execinfo, which glibc and macOS provide
+#if !defined(ESP_PLATFORM) && defined(__has_include)
+#if __has_include(<execinfo.h>)
+#define CTEST__HAS_BACKTRACE 1
+#include <execinfo.h>
+#endif // __has_include(<execinfo.h>)
+#endif // !ESP_PLATFORM && __has_include
+#ifndef CTEST__HAS_BACKTRACE
+#define CTEST__HAS_BACKTRACE 0
+#endif // CTEST__HAS_BACKTRACE
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Size of an allocated block, the requested size where the C library cannot tell.
+ */
+#if CTEST__HAS_USABLE_SIZE
+#define CTEST__SIZE_OF(ptr, size) malloc_usable_size(ptr)
+#else
+#define CTEST__SIZE_OF(ptr, size) (size)
+#endif // CTEST__HAS_USABLE_SIZE
+
+/**
+ * @brief   Caller of the allocator, the site a leaked allocation is reported at. The heap hooks of ESP-IDF run deep in
+ *          the allocator where the caller cannot be found.
+ */
+#if defined(CTEST_WRAP_MALLOC)
+#define CTEST__ALLOC_SITE() __builtin_extract_return_addr(__builtin_return_address(0))
+#else
+#define CTEST__ALLOC_SITE() NULL
+#endif // CTEST_WRAP_MALLOC
+
+/**
+ * @brief   Initial number of slots of the table of live allocations.
+ */
+#define CTEST_LEAK_TABLE_SIZE 1024
+
+/**
+ * @brief   Number of leaked allocations of a test listed with their site.
+ */
+#define CTEST_LEAK_REPORT_MAX 8
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Worker thread allocations are attributed to, the test running on it owns them.
+ */
+typedef struct
+{
+    int live;    // Allocations of the running test not freed yet
+    bool active; // A test is running on the thread
+} ctest__heap_owner_t;
+
+/**
+ * @brief   Allocation made by a test and not freed yet.
+ */
+typedef struct
+{
+    void *ptr;                  // Allocated block, NULL for an empty slot
+    size_t size;                // Requested size
+    void *site;                 // Code that called the allocator, NULL if unknown
+    ctest__heap_owner_t *owner; // Worker of the test that made the allocation
+} ctest__allocation_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+#if defined(CTEST_WRAP_MALLOC)
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+#endif // CTEST_WRAP_MALLOC
+#if defined(CTEST_WRAP_MALLOC) || CTEST__HAS_HEAP_HOOKS
+static void ctest__track_alloc(void *ptr, size_t size, size_t usable, void *site);
+static void ctest__track_free(void *ptr, size_t usable);
+static void ctest__add_allocation(void *ptr, size_t size, void *site);
+static void ctest__remove_allocation(void *ptr);
+static bool ctest__grow_allocations(void);
+static void *ctest__raw_calloc(size_t count, size_t size);
+static void ctest__raw_free(void *ptr);
+#endif // CTEST_WRAP_MALLOC || CTEST__HAS_HEAP_HOOKS
+static void ctest__delete_allocation(size_t slot);
+static size_t ctest__hash_ptr(const void *ptr);
+static void ctest__end_leak_failure(ctest__failure_t *failure, const char *msg, ...);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Allocations made by the calling thread, counted since the thread started.
+ */
+static __thread uint64_t ctest__heap_allocs;
+
+/**
+ * @brief   Bytes allocated by the calling thread, counted since the thread started.
+ */
+static __thread uint64_t ctest__heap_bytes;
+
+/**
+ * @brief   Bytes allocated minus bytes freed by the calling thread, negative when it frees memory of other threads.
+ */
+static __thread int64_t ctest__heap_live;
+
+/**
+ * @brief   Highest live bytes of the calling thread since the test started, and the live bytes when it started.
+ */
+static __thread int64_t ctest__heap_peak;
+static __thread int64_t ctest__heap_start;
+
+/**
+ * @brief   Nesting of ctest's own allocations, which are not counted against the test.
+ */
+static __thread int ctest__heap_paused;
+
+/**
+ * @brief   Set by the first counted allocation, tells whether allocations are observed at all.
+ */
+static bool ctest__heap_tracked;
+
+/**
+ * @brief   Owner of the allocations made on the calling thread.
+ */
+static __thread ctest__heap_owner_t ctest__heap_owner;
+
+/**
+ * @brief   Allocations of tests are recorded, set before the first test starts.
+ */
+static bool ctest__leak_check;
+
+/**
+ * @brief   Open addressing table of the live allocations of running tests, guarded by a lock.
+ */
+static ctest__allocation_t *ctest__allocations;
+static size_t ctest__allocation_capacity;
+static size_t ctest__allocation_count;
+static pthread_mutex_t ctest__allocations_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+#if defined(CTEST_WRAP_MALLOC)
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    if (ptr != NULL)
+        ctest__track_alloc(ptr, size, CTEST__SIZE_OF(ptr, size), CTEST__ALLOC_SITE());
+    return ptr;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    if (ptr != NULL)
+        ctest__track_alloc(ptr, count * size, CTEST__SIZE_OF(ptr, count * size), CTEST__ALLOC_SITE());
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    // Moving or resizing a block counts as a new allocation, it costs a call into the allocator all the same
+    size_t old_size = ptr != NULL ? CTEST__SIZE_OF(ptr, 0) : 0;
+    void *resized = __real_realloc(ptr, size);
+    if (ptr != NULL && (resized != NULL || size == 0))
+        ctest__track_free(ptr, old_size);
+    if (resized != NULL)
+        ctest__track_alloc(resized, size, CTEST__SIZE_OF(resized, size), CTEST__ALLOC_SITE());
+    return resized;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL)
+        ctest__track_free(ptr, CTEST__SIZE_OF(ptr, 0));
+    __real_free(ptr);
+}
+#endif // CTEST_WRAP_MALLOC
+
+#if CTEST__HAS_HEAP_HOOKS
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    ctest__track_alloc(ptr, size, size, CTEST__ALLOC_SITE());
+}
+
+void esp_heap_trace_free_hook(void *ptr)
+{
+    ctest__track_free(ptr, heap_caps_get_allocated_size(ptr));
+}
+#endif // CTEST__HAS_HEAP_HOOKS
+
+uint64_t ctest__count_allocs(void)
+{
+    return ctest__heap_allocs;
+}
+
+bool ctest__check_allocs(uint64_t start, uint64_t max, const char *expression, const char *file, const char *test_name,
+                         int line, const char *msg, ...)
+{
+    uint64_t allocs = ctest__heap_allocs - start;
+    bool tracked = __atomic_load_n(&ctest__heap_tracked, __ATOMIC_RELAXED);
+    if (tracked && allocs <= max)
+        return true;
+
+    ctest__failure_t *failure = ctest__begin_failure(expression, file, test_name, line);
+    if (tracked)
+        ctest__add_failure_value(failure, "%" PRIu64 " allocations, at most %" PRIu64 " allowed", allocs, max);
+    else
+        ctest__add_failure_value(failure, "Allocations are not tracked, build ctest with CTEST_WRAP_MALLOC");
+    va_list args;
+    va_start(args, msg);
+    ctest__end_failure(failure, msg, args);
+    va_end(args);
+    return false;
+}
+
+bool ctest__is_heap_tracked(void)
+{
+    return __atomic_load_n(&ctest__heap_tracked, __ATOMIC_RELAXED);
+}
+
+void ctest__enable_leak_check(void)
+{
+    __atomic_store_n(&ctest__leak_check, true, __ATOMIC_RELAXED);
+}
+
+void ctest__reset_heap_stats(void)
+{
+    ctest__heap_allocs = 0;
+    ctest__heap_bytes = 0;
+    ctest__heap_start = ctest__heap_live;
+    ctest__heap_peak = ctest__heap_live;
+    ctest__heap_owner.active = true;
+}
+
+void ctest__get_heap_stats(ctest__result_t *result)
+{
+    ctest__heap_owner.active = false;
+    result->allocs = ctest__heap_allocs;
+    result->alloc_bytes = ctest__heap_bytes;
+    result->peak_heap_bytes = (uint64_t)(ctest__heap_peak - ctest__heap_start);
+}
+
+int ctest__check_leaks(const ctest__test_t *test, ctest__result_t *result, bool report)
+{
+    result->leaked_allocs = 0;
+    result->leaked_bytes = 0;
+    if (__atomic_load_n(&ctest__heap_owner.live, __ATOMIC_RELAXED) <= 0)
+        return 0;
+
+    // Leaks are taken out of the table, so memory a test leaked is reported once
+    ctest__allocation_t leaks[CTEST_LEAK_REPORT_MAX];
+    pthread_mutex_lock(&ctest__allocations_lock);
+    for (size_t slot = 0; slot < ctest__allocation_capacity; slot++)
+    {
+        // Deleting shifts a later entry of the probe sequence into the slot, so the slot is looked at again
+        while (ctest__allocations[slot].ptr != NULL && ctest__allocations[slot].owner == &ctest__heap_owner)
+        {
+            if (result->leaked_allocs < CTEST_LEAK_REPORT_MAX)
+                leaks[result->leaked_allocs] = ctest__allocations[slot];
+            result->leaked_allocs++;
+            result->leaked_bytes += ctest__allocations[slot].size;
+            ctest__delete_allocation(slot);
+        }
+    }
+    __atomic_store_n(&ctest__heap_owner.live, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&ctest__allocations_lock);
+    if (!report || result->leaked_allocs == 0)
+        return 0;
+
+    // Sites are resolved to symbols only for leaks, recording them costs no more than reading the return address
+    int count = result->leaked_allocs < CTEST_LEAK_REPORT_MAX ? (int)result->leaked_allocs : CTEST_LEAK_REPORT_MAX;
+    char **symbols = NULL;
+#if CTEST__HAS_BACKTRACE
+    void *sites[CTEST_LEAK_REPORT_MAX];
+    for (int i = 0; i < count; i++)
+        sites[i] = leaks[i].site;
+    ctest__heap_paused++;
+    symbols = backtrace_symbols(sites, count);
+    ctest__heap_paused--;
+#endif // CTEST__HAS_BACKTRACE
+
+    // Failing mode reports the leaks like a failed assertion at the test definition
+    char size[32];
+    ctest__format_size((double)result->leaked_bytes, size, sizeof(size));
+    bool fail = ctest__options.leaks == CTEST_LEAKS_FAIL;
+    ctest__failure_t *failure = NULL;
+    if (fail)
+    {
+        failure = ctest__begin_failure("no memory leaks", test->file, test->name, test->line);
+        ctest__add_failure_value(failure, "%" PRIu64 " allocations of %s leaked", result->leaked_allocs, size);
+    }
+    else
+    {
+        ctest__print("💧 Test " CTEST_GRYB "%s" CTEST_GRY " leaked %" PRIu64 " allocations of %s:\n", test->name,
+                     result->leaked_allocs, size);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        char site[256];
+        if (leaks[i].site == NULL)
+            snprintf(site, sizeof(site), "unknown site");
+        else if (symbols != NULL)
+            snprintf(site, sizeof(site), "%s", symbols[i]);
+        else
+            snprintf(site, sizeof(site), "%p", leaks[i].site);
+        if (fail)
+            ctest__add_failure_value(failure, "%zu bytes allocated at %s", leaks[i].size, site);
+        else
+            ctest__print("   %zu bytes allocated at %s\n", leaks[i].size, site);
+    }
+    if (result->leaked_allocs > (uint64_t)count)
+    {
+        if (fail)
+            ctest__add_failure_value(failure, "%" PRIu64 " more not listed", result->leaked_allocs - (uint64_t)count);
+        else
+            ctest__print("   %" PRIu64 " more not listed\n", result->leaked_allocs - (uint64_t)count);
+    }
+    if (fail)
+        ctest__end_leak_failure(failure, "");
+#if CTEST__HAS_BACKTRACE
+    ctest__heap_paused++;
+    free(symbols);
+    ctest__heap_paused--;
+#endif // CTEST__HAS_BACKTRACE
+    return fail ? 1 : 0;
+}
+
+void ctest__pause_heap_tracking(void)
+{
+    ctest__heap_paused++;
+}
+
+void ctest__resume_heap_tracking(void)
+{
+    ctest__heap_paused--;
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+#if defined(CTEST_WRAP_MALLOC) || CTEST__HAS_HEAP_HOOKS
+static void ctest__track_alloc(void *ptr, size_t size, size_t usable, void *site)
+{
+    // Called for every allocation of the process, so it only touches variables of the calling thread
+    if (!__atomic_load_n(&ctest__heap_tracked, __ATOMIC_RELAXED))
+        __atomic_store_n(&ctest__heap_tracked, true, __ATOMIC_RELAXED);
+    if (ctest__heap_paused > 0)
+        return;
+    ctest__heap_allocs++;
+    ctest__heap_bytes += usable;
+    ctest__heap_live += (int64_t)usable;
+    if (ctest__heap_live > ctest__heap_peak)
+        ctest__heap_peak = ctest__heap_live;
+    if (ctest__heap_owner.active && __atomic_load_n(&ctest__leak_check, __ATOMIC_RELAXED))
+        ctest__add_allocation(ptr, size, site);
+}
+
+static void ctest__track_free(void *ptr, size_t usable)
+{
+    // Freed blocks leave the table even while paused, the address may be handed out again
+    if (__atomic_load_n(&ctest__allocation_count, __ATOMIC_RELAXED) > 0)
+        ctest__remove_allocation(ptr);
+    if (ctest__heap_paused > 0)
+        return;
+    ctest__heap_live -= (int64_t)usable;
+}
+
+static void ctest__add_allocation(void *ptr, size_t size, void *site)
+{
+    // Table memory comes from the allocator as well, recording it would recurse
+    ctest__heap_paused++;
+    pthread_mutex_lock(&ctest__allocations_lock);
+    if ((ctest__allocation_count + 1) * 4 <= ctest__allocation_capacity * 3 || ctest__grow_allocations())
+    {
+        size_t mask = ctest__allocation_capacity - 1;
+        size_t slot = ctest__hash_ptr(ptr) & mask;
+        while (ctest__allocations[slot].ptr != NULL)
+            slot = (slot + 1) & mask;
+        ctest__allocations[slot] = (ctest__allocation_t){ptr, size, site, &ctest__heap_owner};
+        __atomic_store_n(&ctest__allocation_count, ctest__allocation_count + 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&ctest__heap_owner.live, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&ctest__allocations_lock);
+    ctest__heap_paused--;
+}
+
+static void ctest__remove_allocation(void *ptr)
+{
+    pthread_mutex_lock(&ctest__allocations_lock);
+    size_t mask = ctest__allocation_capacity - 1;
+    for (size_t slot = ctest__hash_ptr(ptr) & mask; ctest__allocations[slot].ptr != NULL; slot = (slot + 1) & mask)
+    {
+        if (ctest__allocations[slot].ptr == ptr)
+        {
+            __atomic_sub_fetch(&ctest__allocations[slot].owner->live, 1, __ATOMIC_RELAXED);
+            ctest__delete_allocation(slot);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctest__allocations_lock);
+}
+
+static bool ctest__grow_allocations(void)
+{
+    size_t capacity = ctest__allocation_capacity > 0 ? ctest__allocation_capacity * 2 : CTEST_LEAK_TABLE_SIZE;
+    ctest__allocation_t *allocations = (ctest__allocation_t *)ctest__raw_calloc(capacity, sizeof(ctest__allocation_t));
+    if (allocations == NULL)
+        return false;
+    for (size_t i = 0; i < ctest__allocation_capacity; i++)
+    {
+        if (ctest__allocations[i].ptr == NULL)
+            continue;
+        size_t slot = ctest__hash_ptr(ctest__allocations[i].ptr) & (capacity - 1);
+        while (allocations[slot].ptr != NULL)
+            slot = (slot + 1) & (capacity - 1);
+        allocations[slot] = ctest__allocations[i];
+    }
+    ctest__raw_free(ctest__allocations);
+    ctest__allocations = allocations;
+    ctest__allocation_capacity = capacity;
+    return true;
+}
+
+static void *ctest__raw_calloc(size_t count, size_t size)
+{
+#if defined(CTEST_WRAP_MALLOC)
+    return __real_calloc(count, size);
+#else
+    return calloc(count, size);
+#endif // CTEST_WRAP_MALLOC
+}
+
+static void ctest__raw_free(void *ptr)
+{
+#if defined(CTEST_WRAP_MALLOC)
+    __real_free(ptr);
+#else
+    free(ptr);
+#endif // CTEST_WRAP_MALLOC
+}
+#endif // CTEST_WRAP_MALLOC || CTEST__HAS_HEAP_HOOKS
+
+static void ctest__delete_allocation(size_t slot)
+{
+    // Backward shift deletion, later entries of the probe sequence move into the hole so no tombstones are needed
+    size_t mask = ctest__allocation_capacity - 1;
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; ctest__allocations[next].ptr != NULL; next = (next + 1) & mask)
+    {
+        size_t home = ctest__hash_ptr(ctest__allocations[next].ptr) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            ctest__allocations[hole] = ctest__allocations[next];
+            hole = next;
+        }
+    }
+    ctest__allocations[hole].ptr = NULL;
+    __atomic_store_n(&ctest__allocation_count, ctest__allocation_count - 1, __ATOMIC_RELAXED);
+}
+
+static size_t ctest__hash_ptr(const void *ptr)
+{
+    // Fibonacci hashing, blocks are aligned so the low bits carry no information
+    uint64_t hash = ((uint64_t)(uintptr_t)ptr >> 4) * 0x9e3779b97f4a7c15u;
+    return (size_t)(hash >> 32);
+}
+
+static void ctest__end_leak_failure(ctest__failure_t *failure, const char *msg, ...)
+{
+    va_list args;
+    va_start(args, msg);
+    ctest__end_failure(failure, msg, args);
+    va_end(args);
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,350 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_internal.h
+ * @brief       Types and functions shared between the source files of the CTest library.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+#ifndef CTEST_INTERNAL_H
+#define CTEST_INTERNAL_H
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Upper limit for the number of parallel jobs, guards against typos such as '-j 8000'.
+ */
+#define CTEST_MAX_JOBS 1024
+
+/**
+ * @brief   Default number of tests listed in the slowest tests summary.
+ */
+#define CTEST_SLOWEST_DEFAULT 5
+
+/**
+ * @brief   Default measurement time of a benchmark in milliseconds, split evenly between its repetitions.
+ */
+#define CTEST_BENCH_TIME_DEFAULT 1000
+
+/**
+ * @brief   Default and maximal number of measured repetitions of a benchmark.
+ */
+#define CTEST_BENCH_REPS_DEFAULT 20
+#define CTEST_BENCH_REPS_MAX     64
+
+/**
+ * @brief   Default slowdown of a benchmark median over its baseline in percent, tolerated without a regression.
+ */
+#define CTEST_BENCH_TOLERANCE_DEFAULT 10.0
+
+/**
+ * @brief   Default significance level of the Mann-Whitney U test confirming a benchmark regression.
+ */
+#define CTEST_BENCH_ALPHA_DEFAULT 0.05
+
+/**
+ * @brief   Number of failed assertions of a test recorded for the report, and the size of their messages.
+ */
+#define CTEST_REPORT_FAILURES_MAX 8
+#define CTEST_REPORT_MESSAGE_SIZE 256
+
+/**
+ * @brief   Signal interrupting a test that exceeded its timeout, users of it include signal.h.
+ */
+#define CTEST_TIMEOUT_SIGNAL SIGALRM
+
+/**
+ * @brief   Time a timed out test gets to be reported before the run gives up on it, in milliseconds. A worker process
+ *          is killed after it, a worker thread still stuck on a lock the test held stops the run.
+ */
+#define CTEST_TIMEOUT_GRACE_MS 1000
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Handling of the heap allocations a test did not free.
+ */
+typedef enum
+{
+    CTEST_LEAKS_OFF,    // Allocations are not recorded
+    CTEST_LEAKS_REPORT, // Leaks are listed with the output of the test
+    CTEST_LEAKS_FAIL,   // Leaks are listed and fail the test
+} ctest__leaks_t;
+
+/**
+ * @brief   Hardware performance counters collected per test.
+ */
+typedef enum
+{
+    CTEST_PERF_CYCLES,           // CPU cycles
+    CTEST_PERF_INSTRUCTIONS,     // Retired instructions
+    CTEST_PERF_CACHE_MISSES,     // Last level cache misses
+    CTEST_PERF_BRANCH_MISSES,    // Mispredicted branches
+    CTEST_PERF_CONTEXT_SWITCHES, // Context switches of the worker thread
+    CTEST_PERF_COUNT,            // Number of counters
+} ctest__perf_counter_t;
+
+/**
+ * @brief   Options of a test run, collected from the environment and the command line.
+ */
+typedef struct
+{
+    int jobs;                   // Number of tests executed in parallel
+    bool isolate;               // Run tests in worker processes
+    int slowest;                // Number of tests listed in the slowest tests summary
+    int bench_time;             // Measurement time of a benchmark in milliseconds
+    int bench_reps;             // Number of measured repetitions of a benchmark
+    const char *bench_save;     // File the benchmark samples are written to, NULL to skip
+    const char *bench_baseline; // File with the baseline samples benchmarks are compared against, NULL to skip
+    double bench_tolerance;     // Tolerated slowdown of a benchmark median in percent
+    double bench_alpha;         // Significance level of the regression test
+    const char *filter;         // Patterns selecting the tests to run, NULL to run all
+    bool list;                  // List the selected tests instead of running them
+    const char *reporter;       // Format of the machine readable report, NULL to skip
+    const char *report_file;    // File the report is written to, NULL for stdout
+    int timeout;                // Timeout of tests without their own in milliseconds, 0 for none
+    const char *durations;      // File the durations of tests are loaded from and saved to, NULL to skip
+    int shard_index;            // Index of the shard of the tests to run, counted from 0
+    int shard_count;            // Number of shards the tests are split into, 0 when not sharded
+    ctest__leaks_t leaks;       // Handling of the allocations tests leak
+    bool perf;                  // Collect the hardware performance counters of tests
+    const char *trace;          // File the timeline of the run is written to, NULL to skip
+    const char *cache;          // Directory of the cached results of passed tests, NULL to run every test
+    const char *cache_deps;     // Comma separated files keying the cache in place of the test binary, NULL for none
+} ctest__options_t;
+
+/**
+ * @brief   Literal text between the stars of a glob pattern.
+ */
+typedef struct
+{
+    const char *text; // Text of the piece, '?' matches any character
+    size_t length;    // Length of the text
+    bool has_any;     // Text contains '?'
+} ctest__glob_piece_t;
+
+/**
+ * @brief   Glob pattern compiled into the pieces between its stars.
+ */
+typedef struct
+{
+    const ctest__glob_piece_t *pieces; // Pieces in pattern order
+    int piece_count;                   // Number of pieces
+    bool has_star;                     // Pattern contains at least one '*'
+    bool anchored_start;               // First piece must match at the start of the name
+    bool anchored_end;                 // Last piece must match at the end of the name
+    bool negative;                     // Pattern excludes the tests it matches
+} ctest__glob_t;
+
+/**
+ * @brief   Test filter compiled from a list of glob patterns.
+ */
+typedef struct
+{
+    char *storage;               // Copy of the patterns the pieces point into
+    ctest__glob_t *globs;        // Compiled patterns
+    ctest__glob_piece_t *pieces; // Pieces of all patterns
+    int glob_count;              // Number of patterns
+    int positive_count;          // Number of patterns selecting tests, with none every test is selected
+} ctest__filter_t;
+
+/**
+ * @brief   Duration of a test, used to sort tests by how long they run.
+ */
+typedef struct
+{
+    uint64_t duration_ns; // Duration of the test in nanoseconds
+    int test;             // Index of the test
+} ctest__timing_t;
+
+/**
+ * @brief   Values of the performance counters, either as read or counted over an interval.
+ */
+typedef struct
+{
+    uint64_t values[CTEST_PERF_COUNT]; // Counted events, scaled up when the kernel multiplexed the counters
+    uint64_t enabled_ns;               // Time the counters were enabled
+    uint64_t running_ns;               // Time the counters were counting
+    uint32_t available;                // Bit per counter the kernel provides, 0 when counters are unavailable
+} ctest__perf_t;
+
+/**
+ * @brief   Measurements of a benchmark.
+ */
+typedef struct
+{
+    uint64_t iterations;                     // Iterations per repetition, 0 if the test is not a benchmark
+    int repetitions;                         // Number of measured repetitions
+    double samples_ns[CTEST_BENCH_REPS_MAX]; // Time per operation of each repetition in nanoseconds, sorted
+    ctest__perf_t perf;                      // Counters of all measured repetitions, when collected
+} ctest__bench_t;
+
+/**
+ * @brief   Statistics of the samples of a benchmark.
+ */
+typedef struct
+{
+    double mean_ns;   // Mean time per operation in nanoseconds
+    double min_ns;    // Fastest repetition
+    double median_ns; // Median repetition
+    double p99_ns;    // 99th percentile of the repetitions
+    double stddev_ns; // Sample standard deviation of the repetitions
+} ctest__bench_stats_t;
+
+/**
+ * @brief   Outcome of a single test.
+ */
+typedef struct
+{
+    int failed_assertions;    // Number of failed assertions
+    int signal;               // Signal that terminated the worker process running the test, 0 if it did not crash
+    int exit_status;          // Status the test passed to exit() while running in a worker process, -1 if it returned
+    bool timed_out;           // Test exceeded its timeout and was abandoned
+    bool cached;              // Test passed before with the same cache key and was not run
+    uint64_t cache_key;       // Key of the result in the cache, 0 when it is not cached
+    size_t arena_bytes;       // Bytes the test allocated from its arena
+    uint64_t allocs;          // Heap allocations of the test, counted when allocations are tracked
+    uint64_t alloc_bytes;     // Bytes the test allocated from the heap
+    uint64_t peak_heap_bytes; // Highest heap usage of the test above the usage when it started
+    uint64_t leaked_allocs;   // Heap allocations of the test it did not free, counted when leaks are checked
+    uint64_t leaked_bytes;    // Requested bytes of the leaked allocations
+    uint64_t duration_ns;     // Wall-clock duration of the test in nanoseconds
+    ctest__perf_t perf;       // Performance counters of the test, when collected
+    ctest__bench_t bench;     // Measurements, if the test is a benchmark
+} ctest__result_t;
+
+/**
+ * @brief   Failed assertion recorded for the report.
+ */
+typedef struct
+{
+    const char *file;                        // Source file of the assertion
+    int line;                                // Line of the assertion
+    const char *expression;                  // Asserted expression
+    char values[CTEST_REPORT_MESSAGE_SIZE];  // Values of the operands of a comparison, empty for other assertions
+    char message[CTEST_REPORT_MESSAGE_SIZE]; // Formatted message of the assertion, truncated if too long
+} ctest__failure_t;
+
+/**
+ * @brief   First failed assertions of a test, recorded only while a report is written.
+ */
+typedef struct
+{
+    int count;                                        // Number of recorded failures
+    ctest__failure_t items[CTEST_REPORT_FAILURES_MAX]; // Recorded failures
+} ctest__failures_t;
+
+/**
+ * @brief   State of a test run shared between the workers executing it.
+ */
+typedef struct
+{
+    const ctest__test_t *tests; // Tests to run
+    int test_count;             // Number of tests to run
+    ctest__result_t *results;   // Result per test, each slot is written only by the worker running it
+    int next_test;              // Index of the next test to dispatch, claimed atomically by the workers
+} ctest__run_t;
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Options of the current test run.
+ */
+extern ctest__options_t ctest__options;
+
+/**
+ * @brief   Result of the test running on the calling thread, NULL outside of a test.
+ */
+extern __thread ctest__result_t *ctest__current_result;
+
+/**
+ * @brief   Failures of the test running on the calling thread, NULL when failures are not recorded.
+ */
+extern __thread ctest__failures_t *ctest__current_failures;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+int ctest__parse_count(const char *value, const char *what);
+double ctest__parse_double(const char *value, const char *what);
+uint64_t ctest__get_time_ns(void);
+const char *ctest__format_duration(double ns, char *buffer, size_t size);
+const char *ctest__format_rate(double per_second, char *buffer, size_t size);
+const char *ctest__format_size(double bytes, char *buffer, size_t size);
+int ctest__compare_timing(const void *a, const void *b);
+int ctest__compare_double(const void *a, const void *b);
+int ctest__check_benches(const ctest__run_t *run, int *compared);
+void ctest__get_bench_stats(const ctest__bench_t *bench, ctest__bench_stats_t *stats);
+bool ctest__compile_filter(const char *patterns, ctest__filter_t *filter);
+bool ctest__match_filter(const ctest__filter_t *filter, const char *name);
+void ctest__free_filter(ctest__filter_t *filter);
+void ctest__init_output(void);
+void ctest__print(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void ctest__prepare_output(void);
+const char *ctest__vprint(const char *format, va_list args);
+void ctest__flush_output(void);
+void ctest__dump_output(void);
+void *ctest__get_output_ref(void);
+size_t ctest__get_output_length(void);
+void ctest__dump_pending_output(void *output, size_t length);
+ctest__failure_t *ctest__begin_failure(const char *expression, const char *file, const char *test_name, int line);
+void ctest__add_failure_value(ctest__failure_t *failure, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void ctest__add_failure_operand(ctest__failure_t *failure, const char *text, const char *value, bool quoted);
+void ctest__end_failure(ctest__failure_t *failure, const char *msg, va_list args);
+void ctest__open_report(const ctest__run_t *run);
+void ctest__report_test(const ctest__run_t *run, int test, const ctest__failures_t *failures);
+void ctest__close_report(int failed, uint64_t duration_ns);
+void ctest__abort_report(const ctest__test_t *test, uint64_t timeout_ns);
+const char *ctest__get_status(const ctest__result_t *result);
+bool ctest__start_watchdog(void);
+void ctest__stop_watchdog(void);
+int ctest__run_watched(const ctest__test_t *test, uint64_t timeout_ns, bool *timed_out);
+void ctest__finish_watched(void);
+void ctest__print_backtrace(void);
+void ctest__init_process_timeout(void);
+void ctest__schedule_tests(ctest__test_t *tests, int test_count, const char *path);
+void ctest__save_durations(const char *path, const ctest__run_t *run);
+void ctest__reset_arena(void);
+size_t ctest__get_arena_used(void);
+void ctest__free_arena(void);
+bool ctest__is_heap_tracked(void);
+void ctest__reset_heap_stats(void);
+void ctest__get_heap_stats(ctest__result_t *result);
+void ctest__enable_leak_check(void);
+int ctest__check_leaks(const ctest__test_t *test, ctest__result_t *result, bool report);
+void ctest__pause_heap_tracking(void);
+void ctest__resume_heap_tracking(void);
+bool ctest__open_perf(void);
+void ctest__read_perf(ctest__perf_t *perf);
+void ctest__sub_perf(ctest__perf_t *perf, const ctest__perf_t *start);
+void ctest__add_perf(ctest__perf_t *total, const ctest__perf_t *perf);
+void ctest__close_perf(void);
+const char *ctest__get_perf_key(int counter);
+const char *ctest__format_perf(const ctest__perf_t *perf, double per, const char *unit, char *buffer, size_t size);
+bool ctest__open_trace(const char *path);
+void ctest__trace_slice(const char *name, const char *category, uint64_t start_ns, uint64_t end_ns, const char *args);
+void ctest__trace_fixture(const char *fixture, const char *phase, uint64_t start_ns);
+void ctest__flush_trace(void);
+void ctest__free_trace(void);
+void ctest__close_trace(void);
+void ctest__prepare_fixtures(const ctest__run_t *run);
+int ctest__release_test_fixture(void);
+void ctest__teardown_fixtures(const ctest__test_t *tests, int test_count);
+int ctest__check_cache(const char *dir, const char *deps, const ctest__test_t *tests, int test_count,
+                       ctest__result_t *results);
+void ctest__save_cache(const char *dir, const ctest__run_t *run);
+int ctest__shard_tests(ctest__test_t *tests, int test_count, int shard_index, int shard_count, const char *path);
+
+#endif /* CTEST_INTERNAL_H */
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,236 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_mem.c
+ * @brief       Vectorized search for the first difference of two buffers and its report.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Vector search needs SSE2, which every x86-64 CPU has, AVX2 is picked at run time when the CPU supports it
+#if (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))) && (defined(__GNUC__) || defined(__clang__))
+#define CTEST__HAS_SSE2 1
+#include <immintrin.h>
+#else
+#define CTEST__HAS_SSE2 0
+#endif // Vector search
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Number of bytes per row of the hex window printed around the first difference.
+ */
+#define CTEST_MEM_ROW_SIZE 16
+
+/**
+ * @brief   Number of rows printed before and after the row with the first difference.
+ */
+#define CTEST_MEM_CONTEXT_ROWS 1
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Implementation of the first difference search.
+ */
+typedef size_t (*ctest__find_mismatch_fn_t)(const uint8_t *a, const uint8_t *b, size_t size);
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static size_t ctest__find_mismatch_scalar(const uint8_t *a, const uint8_t *b, size_t size);
+#if CTEST__HAS_SSE2
+static size_t ctest__find_mismatch_sse2(const uint8_t *a, const uint8_t *b, size_t size);
+static size_t ctest__find_mismatch_avx2(const uint8_t *a, const uint8_t *b, size_t size);
+#endif // CTEST__HAS_SSE2
+static ctest__find_mismatch_fn_t ctest__select_find_mismatch(void);
+static void ctest__print_hex_row(const char *text, int text_width, const uint8_t *data, const uint8_t *other,
+                                 size_t row, size_t size);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Implementation picked for the CPU on first use, NULL until then.
+ */
+static ctest__find_mismatch_fn_t ctest__find_mismatch_impl;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+size_t ctest__find_mismatch(const void *a, const void *b, size_t size)
+{
+    if (a == b || size == 0)
+        return size;
+    if (a == NULL || b == NULL)
+        return 0;
+
+    // Equal buffers are the common case, the tuned memcmp of the C library confirms them at full speed whatever the
+    // library was built with, the search below only runs to locate the difference
+    if (memcmp(a, b, size) == 0)
+        return size;
+
+    // Racing threads all pick the same implementation, so a relaxed store is enough
+    ctest__find_mismatch_fn_t find = __atomic_load_n(&ctest__find_mismatch_impl, __ATOMIC_RELAXED);
+    if (find == NULL)
+    {
+        find = ctest__select_find_mismatch();
+        __atomic_store_n(&ctest__find_mismatch_impl, find, __ATOMIC_RELAXED);
+    }
+    return find((const uint8_t *)a, (const uint8_t *)b, size);
+}
+
+void ctest__fail_mem(const char *expression, const char *left_text, const char *right_text, const void *left,
+                     const void *right, size_t size, size_t offset, const char *file, const char *test_name, int line,
+                     const char *msg, ...)
+{
+    ctest__failure_t *failure = ctest__begin_failure(expression, file, test_name, line);
+    if (left == NULL || right == NULL)
+    {
+        ctest__add_failure_value(failure, "%s is NULL, %zu bytes compared", left == NULL ? left_text : right_text,
+                                 size);
+    }
+    else
+    {
+        const uint8_t *a = (const uint8_t *)left;
+        const uint8_t *b = (const uint8_t *)right;
+        ctest__add_failure_value(failure, "First difference at offset %zu of %zu bytes", offset, size);
+        ctest__add_failure_value(failure, "%s[%zu] = 0x%02x, %s[%zu] = 0x%02x", left_text, offset, a[offset],
+                                 right_text, offset, b[offset]);
+
+        // Hex window of the rows around the difference, differing bytes are highlighted
+        size_t row = offset / CTEST_MEM_ROW_SIZE;
+        size_t first = row > CTEST_MEM_CONTEXT_ROWS ? row - CTEST_MEM_CONTEXT_ROWS : 0;
+        size_t last = row + CTEST_MEM_CONTEXT_ROWS;
+        int text_width = (int)(strlen(left_text) > strlen(right_text) ? strlen(left_text) : strlen(right_text));
+        for (row = first; row <= last && row * CTEST_MEM_ROW_SIZE < size; row++)
+        {
+            ctest__print_hex_row(left_text, text_width, a, b, row, size);
+            ctest__print_hex_row(right_text, text_width, b, a, row, size);
+        }
+    }
+
+    va_list args;
+    va_start(args, msg);
+    ctest__end_failure(failure, msg, args);
+    va_end(args);
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static size_t ctest__find_mismatch_scalar(const uint8_t *a, const uint8_t *b, size_t size)
+{
+    // Word at a time, memcpy keeps the loads legal for unaligned buffers and compiles to plain loads
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t x, y;
+        memcpy(&x, &a[i], sizeof(x));
+        memcpy(&y, &b[i], sizeof(y));
+        if (x != y)
+            break;
+    }
+    for (; i < size; i++)
+    {
+        if (a[i] != b[i])
+            return i;
+    }
+    return size;
+}
+
+#if CTEST__HAS_SSE2
+static size_t ctest__find_mismatch_sse2(const uint8_t *a, const uint8_t *b, size_t size)
+{
+    // 64 bytes per iteration, the four compares are combined so the loop has a single branch
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&a[i]), _mm_loadu_si128((const __m128i *)&b[i]));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&a[i + 16]),
+                                     _mm_loadu_si128((const __m128i *)&b[i + 16]));
+        __m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&a[i + 32]),
+                                     _mm_loadu_si128((const __m128i *)&b[i + 32]));
+        __m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&a[i + 48]),
+                                     _mm_loadu_si128((const __m128i *)&b[i + 48]));
+        __m128i eq = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+        if (_mm_movemask_epi8(eq) != 0xffff)
+            break;
+    }
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&a[i]), _mm_loadu_si128((const __m128i *)&b[i]));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq) ^ 0xffffu;
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + ctest__find_mismatch_scalar(&a[i], &b[i], size - i);
+}
+
+__attribute__((target("avx2"))) static size_t ctest__find_mismatch_avx2(const uint8_t *a, const uint8_t *b,
+                                                                        size_t size)
+{
+    // 128 bytes per iteration, the four compares are combined so the loop has a single branch
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128)
+    {
+        __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&a[i]),
+                                        _mm256_loadu_si256((const __m256i *)&b[i]));
+        __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&a[i + 32]),
+                                        _mm256_loadu_si256((const __m256i *)&b[i + 32]));
+        __m256i eq2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&a[i + 64]),
+                                        _mm256_loadu_si256((const __m256i *)&b[i + 64]));
+        __m256i eq3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&a[i + 96]),
+                                        _mm256_loadu_si256((const __m256i *)&b[i + 96]));
+        __m256i eq = _mm256_and_si256(_mm256_and_si256(eq0, eq1), _mm256_and_si256(eq2, eq3));
+        if ((unsigned int)_mm256_movemask_epi8(eq) != 0xffffffffu)
+            break;
+    }
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)&a[i]),
+                                       _mm256_loadu_si256((const __m256i *)&b[i]));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(eq);
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + ctest__find_mismatch_sse2(&a[i], &b[i], size - i);
+}
+#endif // CTEST__HAS_SSE2
+
+static ctest__find_mismatch_fn_t ctest__select_find_mismatch(void)
+{
+#if CTEST__HAS_SSE2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ctest__find_mismatch_avx2;
+    return ctest__find_mismatch_sse2;
+#else
+    return ctest__find_mismatch_scalar;
+#endif // CTEST__HAS_SSE2
+}
+
+static void ctest__print_hex_row(const char *text, int text_width, const uint8_t *data, const uint8_t *other,
+                                 size_t row, size_t size)
+{
+    size_t start = row * CTEST_MEM_ROW_SIZE;
+    ctest__print("   %-*s %08zx:", text_width, text, start);
+    for (size_t i = start; i < start + CTEST_MEM_ROW_SIZE && i < size; i++)
+    {
+        if (data[i] != other[i])
+            ctest__print(" " CTEST_RED "%02x" CTEST_GRY, data[i]);
+        else
+            ctest__print(" %02x", data[i]);
+    }
+    ctest__print("\n");
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,326 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_output.c
+ * @brief       Buffered output of the tests, written in batches by a single writer.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest_internal.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Batched writes need writev, elsewhere every chunk is written through stdio
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(ESP_PLATFORM)
+#define CTEST__HAS_WRITEV 1
+#include <errno.h>
+#include <signal.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#define CTEST__HAS_WRITEV 0
+#endif // Batched writes
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Initial capacity of an output chunk in bytes, enough for the result line and a few assertion messages.
+ */
+#define CTEST_OUTPUT_CHUNK_SIZE 1024
+
+/**
+ * @brief   Maximal number of chunks written by a single writev call, well below IOV_MAX of all supported platforms.
+ */
+#define CTEST_OUTPUT_BATCH_MAX 64
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Output of one test, written as a whole so messages of tests running in parallel never interleave.
+ */
+typedef struct ctest__chunk
+{
+    struct ctest__chunk *next; // Next chunk waiting to be written
+    size_t length;             // Number of bytes in data
+    size_t capacity;           // Size of data
+    char data[];               // Output of the test
+} ctest__chunk_t;
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Chunk collecting the output of the calling thread, NULL until something is printed.
+ */
+static __thread ctest__chunk_t *ctest__output;
+
+/**
+ * @brief   Chunks handed over by the workers and not written yet, a lock-free stack in reverse order of submission.
+ */
+static ctest__chunk_t *ctest__pending;
+
+/**
+ * @brief   Set while a thread writes the pending chunks, there is only ever one writer.
+ */
+static int ctest__writing;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static bool ctest__reserve_output(size_t size);
+static void ctest__write_pending(void);
+static void ctest__write_chunks(ctest__chunk_t *chunks);
+static void ctest__exit_output(void);
+#if CTEST__HAS_WRITEV
+static void ctest__crash_output(int signal);
+#endif // CTEST__HAS_WRITEV
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+void ctest__init_output(void)
+{
+    // A test may end the process with exit() or a crash, its output must still reach the terminal
+    atexit(ctest__exit_output);
+#if CTEST__HAS_WRITEV
+    static const int signals[] = {SIGABRT, SIGBUS, SIGFPE, SIGILL, SIGSEGV};
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = ctest__crash_output;
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+        sigaction(signals[i], &action, NULL);
+#endif // CTEST__HAS_WRITEV
+}
+
+void ctest__prepare_output(void)
+{
+    // Allocated before the test starts, so reporting a failure rarely has to allocate
+    ctest__reserve_output(CTEST_OUTPUT_CHUNK_SIZE);
+}
+
+void ctest__print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    ctest__vprint(format, args);
+    va_end(args);
+}
+
+const char *ctest__vprint(const char *format, va_list args)
+{
+    // Most messages fit the free space of the chunk, so they are formatted in place with a single pass
+    va_list retry;
+    va_copy(retry, args);
+    size_t free_space = ctest__output != NULL ? ctest__output->capacity - ctest__output->length : 0;
+    int length = vsnprintf(free_space > 0 ? &ctest__output->data[ctest__output->length] : NULL, free_space, format,
+                           args);
+    if (length >= 0 && (size_t)length >= free_space)
+    {
+        if (ctest__reserve_output((size_t)length + 1))
+            vsnprintf(&ctest__output->data[ctest__output->length], (size_t)length + 1, format, retry);
+        else
+            length = -1;
+    }
+    const char *text = NULL;
+    if (length < 0)
+    {
+        // Out of memory, keep the message by writing it directly
+        vfprintf(stderr, format, retry);
+    }
+    else
+    {
+        text = &ctest__output->data[ctest__output->length];
+        ctest__output->length += (size_t)length;
+    }
+    va_end(retry);
+    return text;
+}
+
+void ctest__flush_output(void)
+{
+    ctest__chunk_t *chunk = ctest__output;
+    if (chunk == NULL)
+        return;
+    ctest__output = NULL;
+
+    chunk->next = __atomic_load_n(&ctest__pending, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&ctest__pending, &chunk->next, chunk, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED))
+        ;
+    ctest__write_pending();
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static bool ctest__reserve_output(size_t size)
+{
+    size_t length = ctest__output != NULL ? ctest__output->length : 0;
+    size_t capacity = ctest__output != NULL ? ctest__output->capacity : 0;
+    if (capacity - length >= size)
+        return true;
+
+    capacity = capacity > 0 ? capacity : CTEST_OUTPUT_CHUNK_SIZE;
+    while (capacity - length < size)
+        capacity *= 2;
+    ctest__pause_heap_tracking();
+    ctest__chunk_t *chunk = (ctest__chunk_t *)realloc(ctest__output, sizeof(ctest__chunk_t) + capacity);
+    ctest__resume_heap_tracking();
+    if (chunk == NULL)
+        return false;
+    chunk->length = length;
+    chunk->capacity = capacity;
+    ctest__output = chunk;
+    return true;
+}
+
+static void ctest__write_pending(void)
+{
+    // Whoever finds the writer idle becomes the writer, a chunk pushed meanwhile is picked up by the next round
+    while (__atomic_load_n(&ctest__pending, __ATOMIC_SEQ_CST) != NULL &&
+           !__atomic_exchange_n(&ctest__writing, 1, __ATOMIC_ACQUIRE))
+    {
+        ctest__chunk_t *stack = __atomic_exchange_n(&ctest__pending, NULL, __ATOMIC_ACQUIRE);
+        ctest__chunk_t *chunks = NULL;
+        while (stack != NULL)
+        {
+            ctest__chunk_t *next = stack->next;
+            stack->next = chunks;
+            chunks = stack;
+            stack = next;
+        }
+        ctest__write_chunks(chunks);
+        __atomic_store_n(&ctest__writing, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void ctest__write_chunks(ctest__chunk_t *chunks)
+{
+#if CTEST__HAS_WRITEV
+    // Anything printed through stdio before must come first
+    fflush(stderr);
+    while (chunks != NULL)
+    {
+        struct iovec iov[CTEST_OUTPUT_BATCH_MAX];
+        int count = 0;
+        for (ctest__chunk_t *chunk = chunks; chunk != NULL && count < CTEST_OUTPUT_BATCH_MAX; chunk = chunk->next)
+        {
+            iov[count].iov_base = chunk->data;
+            iov[count].iov_len = chunk->length;
+            count++;
+        }
+
+        // Short writes are rare, writing resumes at the first byte that was not written
+        int first = 0;
+        while (first < count)
+        {
+            ssize_t written = writev(STDERR_FILENO, &iov[first], count - first);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                break;
+            while (first < count && (size_t)written >= iov[first].iov_len)
+                written -= (ssize_t)iov[first++].iov_len;
+            if (first < count)
+            {
+                iov[first].iov_base = (char *)iov[first].iov_base + written;
+                iov[first].iov_len -= (size_t)written;
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            ctest__chunk_t *next = chunks->next;
+            free(chunks);
+            chunks = next;
+        }
+    }
+#else
+    while (chunks != NULL)
+    {
+        ctest__chunk_t *next = chunks->next;
+        fwrite(chunks->data, 1, chunks->length, stderr);
+        free(chunks);
+        chunks = next;
+    }
+#endif // CTEST__HAS_WRITEV
+}
+
+void ctest__dump_output(void)
+{
+#if CTEST__HAS_WRITEV
+    // Only async-signal-safe calls, the chunk of the current test is written as is
+    if (ctest__output != NULL)
+    {
+        ssize_t unused = write(STDERR_FILENO, ctest__output->data, ctest__output->length);
+        (void)unused;
+    }
+#endif // CTEST__HAS_WRITEV
+}
+
+void *ctest__get_output_ref(void)
+{
+    return &ctest__output;
+}
+
+size_t ctest__get_output_length(void)
+{
+    return ctest__output != NULL ? ctest__output->length : 0;
+}
+
+void ctest__dump_pending_output(void *output, size_t length)
+{
+#if CTEST__HAS_WRITEV
+    // Only async-signal-safe calls and nothing is freed, the caller exits right after. Chunks a stuck writer took off
+    // the stack are lost with it.
+    ctest__chunk_t *stack = __atomic_exchange_n(&ctest__pending, NULL, __ATOMIC_ACQUIRE);
+    ctest__chunk_t *chunks = NULL;
+    while (stack != NULL)
+    {
+        ctest__chunk_t *next = stack->next;
+        stack->next = chunks;
+        chunks = stack;
+        stack = next;
+    }
+    for (ctest__chunk_t *chunk = chunks; chunk != NULL; chunk = chunk->next)
+    {
+        ssize_t unused = write(STDERR_FILENO, chunk->data, chunk->length);
+        (void)unused;
+    }
+    // Output the stuck thread collected since it last flushed, up to the given length
+    ctest__chunk_t *chunk = output != NULL ? __atomic_load_n((ctest__chunk_t **)output, __ATOMIC_ACQUIRE) : NULL;
+    if (chunk != NULL)
+    {
+        ssize_t unused = write(STDERR_FILENO, chunk->data, chunk->length < length ? chunk->length : length);
+        (void)unused;
+    }
+#else
+    (void)output;
+    (void)length;
+#endif // CTEST__HAS_WRITEV
+}
+
+static void ctest__exit_output(void)
+{
+    ctest__flush_output();
+    ctest__write_pending();
+}
+
+#if CTEST__HAS_WRITEV
+static void ctest__crash_output(int signal)
+{
+    int saved_errno = errno;
+    ctest__dump_output();
+    errno = saved_errno;
+    raise(signal);
+}
+#endif // CTEST__HAS_WRITEV
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,251 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_perf.c
+ * @brief       Hardware performance counters of tests and benchmarks, read from a perf_event_open counter group.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest_internal.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Counters are read through the perf events of Linux, elsewhere they are reported as unavailable
+#if defined(__linux__) && !defined(ESP_PLATFORM) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define CTEST__HAS_PERF 1
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __has_include(<linux/perf_event.h>)
+#endif // __linux__ && !ESP_PLATFORM && __has_include
+#ifndef CTEST__HAS_PERF
+#define CTEST__HAS_PERF 0
+#endif // CTEST__HAS_PERF
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+#if CTEST__HAS_PERF
+/**
+ * @brief   Perf event of a counter.
+ */
+typedef struct
+{
+    uint32_t type;   // Type of the event, hardware or software
+    uint64_t config; // Event of the type
+} ctest__perf_event_t;
+
+/**
+ * @brief   Layout of a read of the counter group.
+ */
+typedef struct
+{
+    uint64_t count;                    // Number of counters in the group
+    uint64_t enabled_ns;               // Time the group was enabled
+    uint64_t running_ns;               // Time the group was counting, less than enabled when counters are multiplexed
+    uint64_t values[CTEST_PERF_COUNT]; // Counter values in the order the counters joined the group
+} ctest__perf_read_t;
+#endif // CTEST__HAS_PERF
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Names of the counters, used as keys of the machine readable report.
+ */
+static const char *const ctest__perf_keys[CTEST_PERF_COUNT] = {
+    "cycles", "instructions", "cache_misses", "branch_misses", "context_switches",
+};
+
+/**
+ * @brief   Names of the counters shown next to the duration of a test.
+ */
+static const char *const ctest__perf_names[CTEST_PERF_COUNT] = {
+    "cycles", "instructions", "cache misses", "branch misses", "context switches",
+};
+
+#if CTEST__HAS_PERF
+/**
+ * @brief   Events of the counters, in the order of ctest__perf_counter_t.
+ */
+static const ctest__perf_event_t ctest__perf_events[CTEST_PERF_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+/**
+ * @brief   Counter group of the calling thread, opened on first use. The first counter opened leads the group, so all
+ *          of them count over the same time and their ratios hold.
+ */
+static __thread bool ctest__perf_opened;
+static __thread int ctest__perf_leader = -1;
+static __thread int ctest__perf_fds[CTEST_PERF_COUNT];
+static __thread int ctest__perf_slots[CTEST_PERF_COUNT];
+static __thread uint32_t ctest__perf_available;
+#endif // CTEST__HAS_PERF
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+#if CTEST__HAS_PERF
+static int ctest__open_counter(const ctest__perf_event_t *event, int group_fd);
+#endif // CTEST__HAS_PERF
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+bool ctest__open_perf(void)
+{
+#if CTEST__HAS_PERF
+    if (ctest__perf_opened)
+        return ctest__perf_available != 0;
+    ctest__perf_opened = true;
+    ctest__perf_available = 0;
+
+    // Counters the kernel or the CPU do not provide are left out, the rest of the group still counts
+    int joined = 0;
+    for (int i = 0; i < CTEST_PERF_COUNT; i++)
+    {
+        ctest__perf_fds[i] = ctest__open_counter(&ctest__perf_events[i], ctest__perf_leader);
+        ctest__perf_slots[i] = -1;
+        if (ctest__perf_fds[i] < 0)
+            continue;
+        if (ctest__perf_leader < 0)
+            ctest__perf_leader = ctest__perf_fds[i];
+        ctest__perf_slots[i] = joined++;
+        ctest__perf_available |= 1u << i;
+    }
+    return ctest__perf_available != 0;
+#else
+    return false;
+#endif // CTEST__HAS_PERF
+}
+
+void ctest__read_perf(ctest__perf_t *perf)
+{
+    memset(perf, 0, sizeof(*perf));
+#if CTEST__HAS_PERF
+    if (!ctest__open_perf())
+        return;
+    ctest__perf_read_t data;
+    ssize_t size = read(ctest__perf_leader, &data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)))
+        return;
+    for (int i = 0; i < CTEST_PERF_COUNT; i++)
+    {
+        if (ctest__perf_slots[i] >= 0 && (uint64_t)ctest__perf_slots[i] < data.count)
+            perf->values[i] = data.values[ctest__perf_slots[i]];
+    }
+    perf->enabled_ns = data.enabled_ns;
+    perf->running_ns = data.running_ns;
+    perf->available = ctest__perf_available;
+#endif // CTEST__HAS_PERF
+}
+
+void ctest__sub_perf(ctest__perf_t *perf, const ctest__perf_t *start)
+{
+    uint64_t enabled_ns = perf->enabled_ns - start->enabled_ns;
+    uint64_t running_ns = perf->running_ns - start->running_ns;
+    perf->available &= start->available;
+    perf->enabled_ns = enabled_ns;
+    perf->running_ns = running_ns;
+
+    // Group that never got on the CPU counted nothing, one that was multiplexed is scaled to the whole time
+    if (running_ns == 0)
+        perf->available = 0;
+    for (int i = 0; i < CTEST_PERF_COUNT; i++)
+    {
+        uint64_t value = perf->available & (1u << i) ? perf->values[i] - start->values[i] : 0;
+        if (running_ns > 0 && running_ns < enabled_ns)
+            value = (uint64_t)((double)value * (double)enabled_ns / (double)running_ns);
+        perf->values[i] = value;
+    }
+}
+
+void ctest__add_perf(ctest__perf_t *total, const ctest__perf_t *perf)
+{
+    for (int i = 0; i < CTEST_PERF_COUNT; i++)
+        total->values[i] += perf->values[i];
+    total->enabled_ns += perf->enabled_ns;
+    total->running_ns += perf->running_ns;
+    total->available |= perf->available;
+}
+
+void ctest__close_perf(void)
+{
+#if CTEST__HAS_PERF
+    if (!ctest__perf_opened)
+        return;
+    for (int i = 0; i < CTEST_PERF_COUNT; i++)
+    {
+        if (ctest__perf_fds[i] >= 0)
+            close(ctest__perf_fds[i]);
+    }
+    ctest__perf_leader = -1;
+    ctest__perf_available = 0;
+    ctest__perf_opened = false;
+#endif // CTEST__HAS_PERF
+}
+
+const char *ctest__get_perf_key(int counter)
+{
+    return ctest__perf_keys[counter];
+}
+
+const char *ctest__format_perf(const ctest__perf_t *perf, double per, const char *unit, char *buffer, size_t size)
+{
+    // Instructions per cycle take the place of the instruction count, it is the ratio a regression shows up in
+    int length = 0;
+    buffer[0] = '\0';
+    for (int i = 0; i < CTEST_PERF_COUNT && length < (int)size; i++)
+    {
+        if (!(perf->available & (1u << i)))
+            continue;
+        char count[32];
+        const char *separator = length > 0 ? ", " : "";
+        if (i == CTEST_PERF_INSTRUCTIONS && perf->available & (1u << CTEST_PERF_CYCLES))
+        {
+            double cycles = (double)perf->values[CTEST_PERF_CYCLES];
+            length += snprintf(&buffer[length], size - length, "%sIPC %.2f", separator,
+                               cycles > 0 ? (double)perf->values[i] / cycles : 0.0);
+            continue;
+        }
+        ctest__format_rate((double)perf->values[i] / per, count, sizeof(count));
+        length += snprintf(&buffer[length], size - length, "%s%s %s%s", separator, count, ctest__perf_names[i], unit);
+    }
+    return buffer;
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+#if CTEST__HAS_PERF
+static int ctest__open_counter(const ctest__perf_event_t *event, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_hv = 1;
+
+    // Counting the kernel needs a permissive perf_event_paranoid, user space alone is allowed far more often. Context
+    // switches happen in the kernel, they would always count zero without it.
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0 && (errno == EACCES || errno == EPERM) && event->type == PERF_TYPE_HARDWARE)
+    {
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+#endif // CTEST__HAS_PERF
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,415 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_report.c
+ * @brief       Machine readable reports of a test run in JUnit XML, JSON Lines and TAP formats.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest_internal.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Writers of the parts of a report.
+ */
+typedef void (*ctest__report_begin_fn_t)(FILE *file, const ctest__run_t *run);
+typedef void (*ctest__report_test_fn_t)(FILE *file, int number, const ctest__test_t *test,
+                                        const ctest__result_t *result, const ctest__failures_t *failures);
+typedef void (*ctest__report_end_fn_t)(FILE *file, int failed, uint64_t duration_ns);
+
+/**
+ * @brief   Format of a report, every test is written as soon as it finishes so the report never has to be held in
+ *          memory and a partial report survives a crash of the runner.
+ */
+typedef struct
+{
+    const char *name;               // Name selecting the reporter
+    ctest__report_begin_fn_t begin; // Writes the header of the report
+    ctest__report_test_fn_t test;   // Writes one finished test
+    ctest__report_end_fn_t end;     // Writes the footer of the report
+} ctest__reporter_t;
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static void ctest__junit_begin(FILE *file, const ctest__run_t *run);
+static void ctest__junit_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                              const ctest__failures_t *failures);
+static void ctest__junit_end(FILE *file, int failed, uint64_t duration_ns);
+static void ctest__jsonl_begin(FILE *file, const ctest__run_t *run);
+static void ctest__jsonl_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                              const ctest__failures_t *failures);
+static void ctest__jsonl_end(FILE *file, int failed, uint64_t duration_ns);
+static void ctest__tap_begin(FILE *file, const ctest__run_t *run);
+static void ctest__tap_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                            const ctest__failures_t *failures);
+static void ctest__tap_end(FILE *file, int failed, uint64_t duration_ns);
+static void ctest__write_xml(FILE *file, const char *text);
+static void ctest__write_json(FILE *file, const char *text);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Available reporters.
+ */
+static const ctest__reporter_t ctest__reporters[] = {
+    {"junit", ctest__junit_begin, ctest__junit_test, ctest__junit_end},
+    {"jsonl", ctest__jsonl_begin, ctest__jsonl_test, ctest__jsonl_end},
+    {"tap", ctest__tap_begin, ctest__tap_test, ctest__tap_end},
+};
+
+/**
+ * @brief   Reporter of the current run, NULL when no report is written.
+ */
+static const ctest__reporter_t *ctest__reporter;
+
+/**
+ * @brief   File the report is written to.
+ */
+static FILE *ctest__report_file;
+
+/**
+ * @brief   Number of tests written to the report so far.
+ */
+static int ctest__reported;
+
+/**
+ * @brief   Number of failed tests written to the report so far and the time the report was opened, for a report the
+ *          run has to end early.
+ */
+static int ctest__report_failed;
+static uint64_t ctest__report_start_ns;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+void ctest__open_report(const ctest__run_t *run)
+{
+    if (ctest__options.reporter == NULL)
+        return;
+
+    for (size_t i = 0; i < sizeof(ctest__reporters) / sizeof(ctest__reporters[0]); i++)
+    {
+        if (strcmp(ctest__reporters[i].name, ctest__options.reporter) == 0)
+            ctest__reporter = &ctest__reporters[i];
+    }
+    if (ctest__reporter == NULL)
+    {
+        fprintf(stderr, "ERROR: Unknown reporter '%s', expected junit, jsonl or tap!\n", ctest__options.reporter);
+        exit(1);
+    }
+
+    ctest__report_file = ctest__options.report_file != NULL ? fopen(ctest__options.report_file, "w") : stdout;
+    if (ctest__report_file == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not write report '%s'!\n", ctest__options.report_file);
+        exit(1);
+    }
+    ctest__report_start_ns = ctest__get_time_ns();
+    ctest__reporter->begin(ctest__report_file, run);
+    fflush(ctest__report_file);
+}
+
+void ctest__report_test(const ctest__run_t *run, int test, const ctest__failures_t *failures)
+{
+    if (ctest__reporter == NULL)
+        return;
+
+    // Tests finish on several workers, hold the stream lock so each one is written as a whole
+    flockfile(ctest__report_file);
+    const char *status = ctest__get_status(&run->results[test]);
+    if (strcmp(status, "passed") != 0 && strcmp(status, "cached") != 0)
+        ctest__report_failed++;
+    ctest__reporter->test(ctest__report_file, ++ctest__reported, &run->tests[test], &run->results[test], failures);
+    fflush(ctest__report_file);
+    funlockfile(ctest__report_file);
+}
+
+void ctest__close_report(int failed, uint64_t duration_ns)
+{
+    if (ctest__reporter == NULL)
+        return;
+
+    ctest__reporter->end(ctest__report_file, failed, duration_ns);
+    if (ctest__report_file == stdout)
+        fflush(stdout);
+    else
+        fclose(ctest__report_file);
+    ctest__reporter = NULL;
+    ctest__report_file = NULL;
+}
+
+void ctest__abort_report(const ctest__test_t *test, uint64_t timeout_ns)
+{
+    if (ctest__reporter == NULL)
+        return;
+
+    // Best effort, the stream already has its buffer and is skipped when a stuck worker holds it mid-test
+    if (ftrylockfile(ctest__report_file) != 0)
+        return;
+    ctest__result_t result;
+    memset(&result, 0, sizeof(result));
+    result.exit_status = -1;
+    result.timed_out = true;
+    result.duration_ns = timeout_ns;
+    ctest__failures_t failures;
+    failures.count = 0;
+    ctest__reporter->test(ctest__report_file, ++ctest__reported, test, &result, &failures);
+    ctest__reporter->end(ctest__report_file, ctest__report_failed + 1, ctest__get_time_ns() - ctest__report_start_ns);
+    fflush(ctest__report_file);
+    funlockfile(ctest__report_file);
+}
+
+const char *ctest__get_status(const ctest__result_t *result)
+{
+    if (result->cached)
+        return "cached";
+    if (result->timed_out)
+        return "timed_out";
+    if (result->signal != 0)
+        return "crashed";
+    if (result->exit_status >= 0)
+        return "exited";
+    return result->failed_assertions > 0 ? "failed" : "passed";
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static void ctest__junit_begin(FILE *file, const ctest__run_t *run)
+{
+    // Failure count and run time are unknown until the end, CI tools derive them from the test cases
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n");
+    fprintf(file, "  <testsuite name=\"ctest\" tests=\"%d\">\n", run->test_count);
+}
+
+static void ctest__junit_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                              const ctest__failures_t *failures)
+{
+    (void)number;
+    fprintf(file, "    <testcase name=\"");
+    ctest__write_xml(file, test->name);
+    fprintf(file, "\" classname=\"");
+    ctest__write_xml(file, test->file);
+    fprintf(file, "\" file=\"");
+    ctest__write_xml(file, test->file);
+    fprintf(file, "\" line=\"%d\" time=\"%.9f\">\n", test->line, (double)result->duration_ns / 1e9);
+
+    for (int i = 0; failures != NULL && i < failures->count; i++)
+    {
+        const ctest__failure_t *failure = &failures->items[i];
+        fprintf(file, "      <failure type=\"assertion\" message=\"Assertion of '");
+        ctest__write_xml(file, failure->expression);
+        fprintf(file, "' failed\">");
+        ctest__write_xml(file, failure->file);
+        fprintf(file, ":%d: ", failure->line);
+        if (failure->values[0] != '\0')
+        {
+            ctest__write_xml(file, failure->values);
+            fprintf(file, "\n");
+        }
+        ctest__write_xml(file, failure->message);
+        fprintf(file, "</failure>\n");
+    }
+    int unlisted = result->failed_assertions - (failures != NULL ? failures->count : 0);
+    if (unlisted > 0)
+        fprintf(file, "      <failure type=\"assertion\" message=\"%d more assertions failed\"/>\n", unlisted);
+    if (result->timed_out)
+        fprintf(file, "      <failure type=\"timeout\" message=\"Timed out\"/>\n");
+    else if (result->signal != 0)
+        fprintf(file, "      <failure type=\"crash\" message=\"Crashed with signal %d\"/>\n", result->signal);
+    else if (result->exit_status >= 0)
+        fprintf(file, "      <failure type=\"exit\" message=\"Exited with status %d\"/>\n", result->exit_status);
+    else if (result->cached)
+        fprintf(file, "      <skipped message=\"Cached\"/>\n");
+    fprintf(file, "    </testcase>\n");
+}
+
+static void ctest__junit_end(FILE *file, int failed, uint64_t duration_ns)
+{
+    (void)failed;
+    (void)duration_ns;
+    fprintf(file, "  </testsuite>\n</testsuites>\n");
+}
+
+static void ctest__jsonl_begin(FILE *file, const ctest__run_t *run)
+{
+    fprintf(file, "{\"type\":\"begin\",\"tests\":%d}\n", run->test_count);
+}
+
+static void ctest__jsonl_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                              const ctest__failures_t *failures)
+{
+    (void)number;
+    fprintf(file, "{\"type\":\"test\",\"name\":");
+    ctest__write_json(file, test->name);
+    fprintf(file, ",\"file\":");
+    ctest__write_json(file, test->file);
+    fprintf(file,
+            ",\"line\":%d,\"status\":\"%s\",\"duration_ns\":%" PRIu64
+            ",\"failed_assertions\":%d,\"signal\":%d,\"exit_status\":%d,\"arena_bytes\":%zu,\"allocs\":%" PRIu64
+            ",\"alloc_bytes\":%" PRIu64 ",\"peak_heap_bytes\":%" PRIu64 ",\"leaked_allocs\":%" PRIu64
+            ",\"leaked_bytes\":%" PRIu64 ",\"perf\":{",
+            test->line, ctest__get_status(result), result->duration_ns, result->failed_assertions, result->signal,
+            result->exit_status, result->arena_bytes, result->allocs, result->alloc_bytes, result->peak_heap_bytes,
+            result->leaked_allocs, result->leaked_bytes);
+    // Counters the kernel did not provide are left out rather than reported as zero
+    for (int i = 0, written = 0; i < CTEST_PERF_COUNT; i++)
+    {
+        if (result->perf.available & (1u << i))
+        {
+            fprintf(file, "%s\"%s\":%" PRIu64, written++ > 0 ? "," : "", ctest__get_perf_key(i),
+                    result->perf.values[i]);
+        }
+    }
+    fprintf(file, "},\"failures\":[");
+    for (int i = 0; failures != NULL && i < failures->count; i++)
+    {
+        const ctest__failure_t *failure = &failures->items[i];
+        fprintf(file, "%s{\"file\":", i > 0 ? "," : "");
+        ctest__write_json(file, failure->file);
+        fprintf(file, ",\"line\":%d,\"expression\":", failure->line);
+        ctest__write_json(file, failure->expression);
+        fprintf(file, ",\"values\":");
+        ctest__write_json(file, failure->values);
+        fprintf(file, ",\"message\":");
+        ctest__write_json(file, failure->message);
+        fprintf(file, "}");
+    }
+    fprintf(file, "]}\n");
+}
+
+static void ctest__jsonl_end(FILE *file, int failed, uint64_t duration_ns)
+{
+    fprintf(file, "{\"type\":\"end\",\"tests\":%d,\"failed\":%d,\"duration_ns\":%" PRIu64 "}\n", ctest__reported,
+            failed, duration_ns);
+}
+
+static void ctest__tap_begin(FILE *file, const ctest__run_t *run)
+{
+    fprintf(file, "TAP version 13\n1..%d\n", run->test_count);
+}
+
+static void ctest__tap_test(FILE *file, int number, const ctest__test_t *test, const ctest__result_t *result,
+                            const ctest__failures_t *failures)
+{
+    // Tests are numbered in the order they finish, harnesses expect the numbers to ascend
+    const char *status = ctest__get_status(result);
+    bool passed = strcmp(status, "passed") == 0;
+    if (result->cached)
+    {
+        fprintf(file, "ok %d - %s # SKIP cached\n", number, test->name);
+        return;
+    }
+    fprintf(file, "%s %d - %s # time=%.3fms\n", passed ? "ok" : "not ok", number, test->name,
+            (double)result->duration_ns / 1e6);
+    if (passed)
+        return;
+
+    // YAML double quoted scalars share their escaping with JSON strings
+    fprintf(file, "  ---\n  status: %s\n  failed_assertions: %d\n", status, result->failed_assertions);
+    if (result->signal != 0)
+        fprintf(file, "  signal: %d\n", result->signal);
+    if (result->exit_status >= 0)
+        fprintf(file, "  exit_status: %d\n", result->exit_status);
+    if (failures != NULL && failures->count > 0)
+    {
+        fprintf(file, "  failures:\n");
+        for (int i = 0; i < failures->count; i++)
+        {
+            const ctest__failure_t *failure = &failures->items[i];
+            fprintf(file, "    - at: ");
+            ctest__write_json(file, failure->file);
+            fprintf(file, "\n      line: %d\n      expression: ", failure->line);
+            ctest__write_json(file, failure->expression);
+            if (failure->values[0] != '\0')
+            {
+                fprintf(file, "\n      values: ");
+                ctest__write_json(file, failure->values);
+            }
+            fprintf(file, "\n      message: ");
+            ctest__write_json(file, failure->message);
+            fprintf(file, "\n");
+        }
+    }
+    fprintf(file, "  ...\n");
+}
+
+static void ctest__tap_end(FILE *file, int failed, uint64_t duration_ns)
+{
+    fprintf(file, "# failed %d of %d, duration %.3fms\n", failed, ctest__reported, (double)duration_ns / 1e6);
+}
+
+static void ctest__write_xml(FILE *file, const char *text)
+{
+    for (; *text != '\0'; text++)
+    {
+        switch (*text)
+        {
+        case '&':
+            fputs("&amp;", file);
+            break;
+        case '<':
+            fputs("&lt;", file);
+            break;
+        case '>':
+            fputs("&gt;", file);
+            break;
+        case '"':
+            fputs("&quot;", file);
+            break;
+        case '\'':
+            fputs("&apos;", file);
+            break;
+        default:
+            // Control characters other than whitespace are not allowed in XML 1.0
+            if ((unsigned char)*text >= 0x20 || *text == '\t' || *text == '\n' || *text == '\r')
+                fputc(*text, file);
+            break;
+        }
+    }
+}
+
+static void ctest__write_json(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; *text != '\0'; text++)
+    {
+        switch (*text)
+        {
+        case '"':
+            fputs("\\\"", file);
+            break;
+        case '\\':
+            fputs("\\\\", file);
+            break;
+        case '\n':
+            fputs("\\n", file);
+            break;
+        case '\r':
+            fputs("\\r", file);
+            break;
+        case '\t':
+            fputs("\\t", file);
+            break;
+        default:
+            if ((unsigned char)*text < 0x20)
+                fprintf(file, "\\u%04x", (unsigned char)*text);
+            else
+                fputc(*text, file);
+            break;
+        }
+    }
+    fputc('"', file);
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,538 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_timeout.c
+ * @brief       Watchdog ending tests that exceed their timeout and the backtrace of the timed out test.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+// Stack bounds and registers of an interrupted thread are GNU extensions on Linux
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif // defined(__linux__) && !defined(_GNU_SOURCE)
+
+#include "ctest_internal.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Timeouts interrupt the test with a signal, elsewhere tests run without a time limit
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(ESP_PLATFORM)
+#define CTEST__HAS_WATCHDOG 1
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#else
+#define CTEST__HAS_WATCHDOG 0
+#endif // Timeouts
+
+// Backtraces need execinfo, which glibc and macOS provide
+#if CTEST__HAS_WATCHDOG && defined(__has_include)
+#if __has_include(<execinfo.h>)
+#define CTEST__HAS_BACKTRACE 1
+#include <execinfo.h>
+#endif // __has_include(<execinfo.h>)
+#endif // CTEST__HAS_WATCHDOG && defined(__has_include)
+#ifndef CTEST__HAS_BACKTRACE
+#define CTEST__HAS_BACKTRACE 0
+#endif // CTEST__HAS_BACKTRACE
+
+// Frames of an interrupted test are found by following frame pointers from the registers the signal saved, which needs
+// the register layout of the target
+#if CTEST__HAS_WATCHDOG && (defined(__linux__) || defined(__APPLE__)) && (defined(__x86_64__) || defined(__aarch64__))
+#define CTEST__HAS_FRAME_WALK 1
+#ifdef __APPLE__
+#include <sys/ucontext.h>
+#else
+#include <ucontext.h>
+#endif // __APPLE__
+#else
+#define CTEST__HAS_FRAME_WALK 0
+#endif // Frame walk
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Maximal number of frames in the backtrace of a timed out test.
+ */
+#define CTEST_TIMEOUT_FRAMES 64
+
+// --- Private Types ---------------------------------------------------------------------------------------------------
+
+#if CTEST__HAS_WATCHDOG
+/**
+ * @brief   Watch of a worker thread, the watchdog interrupts the thread when its test runs past the deadline.
+ */
+typedef struct ctest__watch
+{
+    struct ctest__watch *next;          // Next watch of the watchdog
+    pthread_t thread;                   // Worker thread running the watched tests
+    uintptr_t stack_high;               // Top of the stack of the worker thread, 0 when unknown
+    void *output;                       // Output the worker thread collects, see ctest__get_output_ref
+    const ctest__test_t *test;          // Watched test
+    uint64_t timeout_ns;                // Timeout of the watched test
+    uint64_t deadline_ns;               // Time the running test times out, 0 when no test is watched
+    uint64_t fired_ns;                  // Time the watchdog interrupted the test, only used by the watchdog
+    unsigned int generation;            // Incremented for every watched test
+    unsigned int fired;                 // Generation the watchdog interrupted
+    unsigned int printed;               // Generation whose timeout the worker has printed to its output
+    unsigned int finished;              // Generation the worker has reported, it is no longer stuck on it
+    size_t output_length;               // Length of the output of the worker when the test was interrupted
+    volatile sig_atomic_t active;       // Set while the watched test runs, the thread may be interrupted
+    sigjmp_buf jump;                    // Return point of the interrupted test
+    void *frames[CTEST_TIMEOUT_FRAMES]; // Backtrace of the interrupted test
+    int frame_count;                    // Number of frames in the backtrace
+} ctest__watch_t;
+#endif // CTEST__HAS_WATCHDOG
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+#if CTEST__HAS_WATCHDOG
+/**
+ * @brief   Watches of all worker threads, the list only grows while the watchdog runs.
+ */
+static ctest__watch_t *ctest__watches;
+static pthread_mutex_t ctest__watches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief   Watch of the calling thread, NULL until it runs its first watched test.
+ */
+static __thread ctest__watch_t *ctest__current_watch;
+
+/**
+ * @brief   Watchdog thread, its wake-up pipe and the time it wakes up next, 0 while it looks at the deadlines.
+ */
+static pthread_t ctest__watchdog;
+static bool ctest__watchdog_running;
+static bool ctest__watchdog_stop;
+static int ctest__wake_fds[2] = {-1, -1};
+static uint64_t ctest__wake_ns;
+
+/**
+ * @brief   Top of the stack of a worker process, bounds the backtrace of its timed out test.
+ */
+static uintptr_t ctest__process_stack_high;
+#endif // CTEST__HAS_WATCHDOG
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+#if CTEST__HAS_WATCHDOG
+static void *ctest__watchdog_main(void *arg);
+static void ctest__abandon_run(ctest__watch_t *watch, unsigned int generation);
+static ctest__watch_t *ctest__get_watch(void);
+static uintptr_t ctest__get_stack_high(void);
+static int ctest__walk_frames(const void *context, uintptr_t stack_high, void **frames);
+static void ctest__write_backtrace(void *const *frames, int frame_count);
+static void ctest__write_error(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static void ctest__timeout_test(int signal, siginfo_t *info, void *context);
+static void ctest__timeout_process(int signal, siginfo_t *info, void *context);
+#endif // CTEST__HAS_WATCHDOG
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+bool ctest__start_watchdog(void)
+{
+#if CTEST__HAS_WATCHDOG
+    if (pipe(ctest__wake_fds) != 0)
+        return false;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = ctest__timeout_test;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(CTEST_TIMEOUT_SIGNAL, &action, NULL);
+
+    ctest__wake_ns = UINT64_MAX;
+    ctest__watchdog_stop = false;
+    if (pthread_create(&ctest__watchdog, NULL, ctest__watchdog_main, NULL) != 0)
+    {
+        close(ctest__wake_fds[0]);
+        close(ctest__wake_fds[1]);
+        return false;
+    }
+    ctest__watchdog_running = true;
+    return true;
+#else
+    return false;
+#endif // CTEST__HAS_WATCHDOG
+}
+
+void ctest__stop_watchdog(void)
+{
+#if CTEST__HAS_WATCHDOG
+    if (!ctest__watchdog_running)
+        return;
+    __atomic_store_n(&ctest__watchdog_stop, true, __ATOMIC_SEQ_CST);
+    ssize_t unused = write(ctest__wake_fds[1], "", 1);
+    (void)unused;
+    pthread_join(ctest__watchdog, NULL);
+    ctest__watchdog_running = false;
+    close(ctest__wake_fds[0]);
+    close(ctest__wake_fds[1]);
+    signal(CTEST_TIMEOUT_SIGNAL, SIG_DFL);
+
+    // Workers have finished, their watches are no longer referenced
+    ctest__current_watch = NULL;
+    while (ctest__watches != NULL)
+    {
+        ctest__watch_t *next = ctest__watches->next;
+        free(ctest__watches);
+        ctest__watches = next;
+    }
+#endif // CTEST__HAS_WATCHDOG
+}
+
+int ctest__run_watched(const ctest__test_t *test, uint64_t timeout_ns, bool *timed_out)
+{
+    *timed_out = false;
+#if CTEST__HAS_WATCHDOG
+    // Volatile, the watch is used again after the test is abandoned with siglongjmp
+    ctest__watch_t *volatile watch = ctest__watchdog_running ? ctest__get_watch() : NULL;
+    if (watch == NULL || timeout_ns == 0)
+        return test->fn();
+
+    watch->frame_count = 0;
+    watch->test = test;
+    watch->timeout_ns = timeout_ns;
+    // Generation changes before the deadline is armed, the watchdog reads them in the opposite order
+    __atomic_store_n(&watch->generation, watch->generation + 1, __ATOMIC_SEQ_CST);
+    uint64_t deadline_ns = ctest__get_time_ns() + timeout_ns;
+    __atomic_store_n(&watch->deadline_ns, deadline_ns, __ATOMIC_SEQ_CST);
+    // The watchdog only needs waking when this deadline is earlier than the one it waits for
+    if (deadline_ns < __atomic_load_n(&ctest__wake_ns, __ATOMIC_SEQ_CST))
+    {
+        ssize_t unused = write(ctest__wake_fds[1], "", 1);
+        (void)unused;
+    }
+
+    volatile int failed_assertions = 0;
+    if (sigsetjmp(watch->jump, 1) == 0)
+    {
+        watch->active = 1;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        failed_assertions = test->fn();
+        watch->active = 0;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    }
+    else
+    {
+        // Abandoned in the middle, whatever the test held stays held
+        *timed_out = true;
+    }
+    __atomic_store_n(&watch->deadline_ns, 0, __ATOMIC_SEQ_CST);
+    return failed_assertions;
+#else
+    (void)timeout_ns;
+    return test->fn();
+#endif // CTEST__HAS_WATCHDOG
+}
+
+void ctest__finish_watched(void)
+{
+#if CTEST__HAS_WATCHDOG
+    // Timed out test has been reported, the watchdog no longer has to do it in place of the worker
+    ctest__watch_t *watch = ctest__current_watch;
+    if (watch != NULL)
+        __atomic_store_n(&watch->finished, watch->generation, __ATOMIC_SEQ_CST);
+#endif // CTEST__HAS_WATCHDOG
+}
+
+void ctest__print_backtrace(void)
+{
+#if CTEST__HAS_WATCHDOG
+    ctest__watch_t *watch = ctest__current_watch;
+    if (watch == NULL)
+        return;
+    // Called right after the timeout is printed, from here on the output of the worker has the whole report
+    if (watch->frame_count == 0)
+    {
+        __atomic_store_n(&watch->printed, watch->generation, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    // First frame is the interrupted instruction, the rest are return addresses
+#if CTEST__HAS_BACKTRACE
+    char **symbols = backtrace_symbols(watch->frames, watch->frame_count);
+#else
+    char **symbols = NULL;
+#endif // CTEST__HAS_BACKTRACE
+    ctest__print("🔎 Backtrace:\n");
+    for (int i = 0; i < watch->frame_count; i++)
+    {
+        if (symbols != NULL)
+            ctest__print("   %s\n", symbols[i]);
+        else
+            ctest__print("   %p\n", watch->frames[i]);
+    }
+    free(symbols);
+    __atomic_store_n(&watch->printed, watch->generation, __ATOMIC_SEQ_CST);
+#endif // CTEST__HAS_WATCHDOG
+}
+
+void ctest__init_process_timeout(void)
+{
+#if CTEST__HAS_WATCHDOG
+    ctest__process_stack_high = ctest__get_stack_high();
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = ctest__timeout_process;
+    action.sa_flags = SA_SIGINFO | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(CTEST_TIMEOUT_SIGNAL, &action, NULL);
+#endif // CTEST__HAS_WATCHDOG
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+#if CTEST__HAS_WATCHDOG
+static void *ctest__watchdog_main(void *arg)
+{
+    (void)arg;
+    while (!__atomic_load_n(&ctest__watchdog_stop, __ATOMIC_SEQ_CST))
+    {
+        // Workers arming a deadline meanwhile see 0 and wake the watchdog, so no deadline is missed
+        __atomic_store_n(&ctest__wake_ns, 0, __ATOMIC_SEQ_CST);
+        uint64_t now_ns = ctest__get_time_ns();
+        uint64_t next_ns = UINT64_MAX;
+        pthread_mutex_lock(&ctest__watches_lock);
+        for (ctest__watch_t *watch = ctest__watches; watch != NULL; watch = watch->next)
+        {
+            // Generation is read before and after the deadline, a deadline read while the worker moves on to its next
+            // test could belong to either of them and is looked at again on the next pass
+            unsigned int generation = __atomic_load_n(&watch->generation, __ATOMIC_SEQ_CST);
+            uint64_t deadline_ns = __atomic_load_n(&watch->deadline_ns, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&watch->generation, __ATOMIC_SEQ_CST) != generation)
+            {
+                next_ns = now_ns;
+                continue;
+            }
+            // Interrupted test that is not reported within the grace period left its worker stuck on a lock it held,
+            // most likely the one of the allocator, the watchdog reports the test in its place and ends the run
+            if (watch->fired == generation && __atomic_load_n(&watch->finished, __ATOMIC_SEQ_CST) != generation)
+            {
+                uint64_t give_up_ns = watch->fired_ns + (uint64_t)CTEST_TIMEOUT_GRACE_MS * 1000000u;
+                if (now_ns >= give_up_ns)
+                    ctest__abandon_run(watch, generation);
+                next_ns = give_up_ns < next_ns ? give_up_ns : next_ns;
+                continue;
+            }
+            if (deadline_ns == 0)
+                continue;
+            if (deadline_ns > now_ns)
+            {
+                next_ns = deadline_ns < next_ns ? deadline_ns : next_ns;
+                continue;
+            }
+            // Generation tells the handler whether the signal is meant for the test running when it arrives
+            watch->fired_ns = now_ns;
+            __atomic_store_n(&watch->fired, generation, __ATOMIC_SEQ_CST);
+            pthread_kill(watch->thread, CTEST_TIMEOUT_SIGNAL);
+            uint64_t give_up_ns = now_ns + (uint64_t)CTEST_TIMEOUT_GRACE_MS * 1000000u;
+            next_ns = give_up_ns < next_ns ? give_up_ns : next_ns;
+        }
+        pthread_mutex_unlock(&ctest__watches_lock);
+        __atomic_store_n(&ctest__wake_ns, next_ns, __ATOMIC_SEQ_CST);
+
+        int timeout_ms = -1;
+        if (next_ns != UINT64_MAX)
+        {
+            uint64_t wait_ms = (next_ns - now_ns + 999999) / 1000000;
+            timeout_ms = wait_ms < INT32_MAX ? (int)wait_ms : INT32_MAX;
+        }
+        struct pollfd fd = {ctest__wake_fds[0], POLLIN, 0};
+        if (poll(&fd, 1, timeout_ms) > 0)
+        {
+            char buffer[64];
+            ssize_t unused = read(ctest__wake_fds[0], buffer, sizeof(buffer));
+            (void)unused;
+        }
+    }
+    return NULL;
+}
+
+static void ctest__abandon_run(ctest__watch_t *watch, unsigned int generation)
+{
+    const ctest__test_t *test = watch->test;
+    uint64_t timeout_ns = watch->timeout_ns;
+    // Worker coming back meanwhile reports the test itself
+    if (__atomic_load_n(&watch->finished, __ATOMIC_SEQ_CST) == generation)
+        return;
+
+    // Nothing here may allocate, the stuck worker most likely holds the allocator lock. Whatever the worker printed
+    // after the interruption is left out unless it got as far as printing the whole timeout.
+    if (__atomic_load_n(&watch->printed, __ATOMIC_SEQ_CST) == generation)
+    {
+        ctest__dump_pending_output(watch->output, SIZE_MAX);
+    }
+    else
+    {
+        char duration[32];
+        ctest__format_duration((double)timeout_ns, duration, sizeof(duration));
+        ctest__dump_pending_output(watch->output, __atomic_load_n(&watch->output_length, __ATOMIC_ACQUIRE));
+        ctest__write_error("⏰ Test " CTEST_GRYB "%s" CTEST_GRY " timed out after %s!\n", test->name, duration);
+        ctest__write_backtrace(watch->frames, __atomic_load_n(&watch->frame_count, __ATOMIC_ACQUIRE));
+    }
+    ctest__write_error("💥 Test " CTEST_GRYB "%s" CTEST_GRY " did not recover within %d ms, the run is stopped!\n",
+                       test->name, CTEST_TIMEOUT_GRACE_MS);
+    ctest__abort_report(test, timeout_ns);
+    _exit(1);
+}
+
+static ctest__watch_t *ctest__get_watch(void)
+{
+    if (ctest__current_watch != NULL)
+        return ctest__current_watch;
+
+    ctest__pause_heap_tracking();
+    ctest__watch_t *watch = (ctest__watch_t *)calloc(1, sizeof(ctest__watch_t));
+    uintptr_t stack_high = ctest__get_stack_high();
+    ctest__resume_heap_tracking();
+    if (watch == NULL)
+        return NULL;
+    watch->thread = pthread_self();
+    watch->stack_high = stack_high;
+    watch->output = ctest__get_output_ref();
+    // Fired starts out of step with the generation, so the first watched test is not taken as interrupted
+    watch->fired = UINT32_MAX;
+    pthread_mutex_lock(&ctest__watches_lock);
+    watch->next = ctest__watches;
+    ctest__watches = watch;
+    pthread_mutex_unlock(&ctest__watches_lock);
+    ctest__current_watch = watch;
+    return watch;
+}
+
+static uintptr_t ctest__get_stack_high(void)
+{
+#if CTEST__HAS_FRAME_WALK && defined(__APPLE__)
+    return (uintptr_t)pthread_get_stackaddr_np(pthread_self());
+#elif CTEST__HAS_FRAME_WALK
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        return 0;
+    void *stack = NULL;
+    size_t size = 0;
+    uintptr_t stack_high = pthread_attr_getstack(&attr, &stack, &size) == 0 ? (uintptr_t)stack + size : 0;
+    pthread_attr_destroy(&attr);
+    return stack_high;
+#else
+    return 0;
+#endif // CTEST__HAS_FRAME_WALK
+}
+
+static int ctest__walk_frames(const void *context, uintptr_t stack_high, void **frames)
+{
+    // Only reads the stack of the calling thread, unlike backtrace it is async-signal-safe
+#if CTEST__HAS_FRAME_WALK
+    const ucontext_t *ucontext = (const ucontext_t *)context;
+#if defined(__linux__) && defined(__x86_64__)
+    uintptr_t pc = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RIP];
+    uintptr_t sp = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RSP];
+    uintptr_t fp = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RBP];
+#elif defined(__linux__)
+    uintptr_t pc = (uintptr_t)ucontext->uc_mcontext.pc;
+    uintptr_t sp = (uintptr_t)ucontext->uc_mcontext.sp;
+    uintptr_t fp = (uintptr_t)ucontext->uc_mcontext.regs[29];
+#elif defined(__x86_64__)
+    uintptr_t pc = (uintptr_t)ucontext->uc_mcontext->__ss.__rip;
+    uintptr_t sp = (uintptr_t)ucontext->uc_mcontext->__ss.__rsp;
+    uintptr_t fp = (uintptr_t)ucontext->uc_mcontext->__ss.__rbp;
+#else
+    uintptr_t pc = (uintptr_t)ucontext->uc_mcontext->__ss.__pc;
+    uintptr_t sp = (uintptr_t)ucontext->uc_mcontext->__ss.__sp;
+    uintptr_t fp = (uintptr_t)ucontext->uc_mcontext->__ss.__fp;
+#endif // Registers
+    int frame_count = 0;
+    frames[frame_count++] = (void *)pc;
+    // Frame pointers are followed while they are aligned, ascend and stay on the stack, code built without them ends
+    // the walk early instead of faulting
+    while (frame_count < CTEST_TIMEOUT_FRAMES && fp >= sp && fp % sizeof(uintptr_t) == 0 &&
+           fp + 2 * sizeof(uintptr_t) <= stack_high)
+    {
+        const uintptr_t *frame = (const uintptr_t *)fp;
+        if (frame[1] == 0)
+            break;
+        frames[frame_count++] = (void *)frame[1];
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    return frame_count;
+#else
+    (void)context;
+    (void)stack_high;
+    (void)frames;
+    return 0;
+#endif // CTEST__HAS_FRAME_WALK
+}
+
+static void ctest__write_backtrace(void *const *frames, int frame_count)
+{
+#if CTEST__HAS_BACKTRACE
+    static const char header[] = "🔎 Backtrace:\n";
+    if (frame_count == 0)
+        return;
+    ssize_t unused = write(STDERR_FILENO, header, sizeof(header) - 1);
+    (void)unused;
+    backtrace_symbols_fd(frames, frame_count, STDERR_FILENO);
+#else
+    (void)frames;
+    (void)frame_count;
+#endif // CTEST__HAS_BACKTRACE
+}
+
+static void ctest__write_error(const char *format, ...)
+{
+    // Formatted on the stack and written directly, for when the output buffers cannot be allocated
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0)
+        return;
+    ssize_t unused = write(STDERR_FILENO, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    (void)unused;
+}
+
+static void ctest__timeout_test(int signal, siginfo_t *info, void *context)
+{
+    (void)signal;
+    (void)info;
+    // A signal arriving after the test finished, or meant for an earlier test, is dropped
+    ctest__watch_t *watch = ctest__current_watch;
+    if (watch == NULL || !watch->active || __atomic_load_n(&watch->fired, __ATOMIC_SEQ_CST) != watch->generation)
+        return;
+    watch->active = 0;
+    __atomic_store_n(&watch->output_length, ctest__get_output_length(), __ATOMIC_RELEASE);
+    __atomic_store_n(&watch->frame_count, ctest__walk_frames(context, watch->stack_high, watch->frames),
+                     __ATOMIC_RELEASE);
+    siglongjmp(watch->jump, 1);
+}
+
+static void ctest__timeout_process(int signal, siginfo_t *info, void *context)
+{
+    // Worker process is killed by the runner, only async-signal-safe calls write what it knows before it dies
+    (void)info;
+    int saved_errno = errno;
+    ctest__dump_output();
+    void *frames[CTEST_TIMEOUT_FRAMES];
+    ctest__write_backtrace(frames, ctest__walk_frames(context, ctest__process_stack_high, frames));
+    errno = saved_errno;
+    raise(signal);
+}
+#endif // CTEST__HAS_WATCHDOG
+
+// --- EOF -------------------------------------------------------------------------------------------------------------
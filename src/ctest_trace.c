@@ -0,0 +1,231 @@
+/***********************************************************************************************************************
+ *
+ * @file        ctest_trace.c
+ * @brief       Timeline of a test run in the Chrome trace event format, viewable in Perfetto or chrome://tracing.
+ * @author      Blaz Baskovc
+ * @copyright   Copyright 2025 Blaz Baskovc
+ * @date        2025-03-11
+ *
+ **********************************************************************************************************************/
+
+// --- Includes --------------------------------------------------------------------------------------------------------
+
+#include "ctest/ctest.h"
+#include "ctest_internal.h"
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// --- Private Defines -------------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Size of the event buffer of a worker, written to the trace file when full.
+ */
+#define CTEST_TRACE_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief   Longest event written to the buffer, longer names are truncated.
+ */
+#define CTEST_TRACE_EVENT_MAX 512
+
+// --- Private Functions Prototypes ------------------------------------------------------------------------------------
+
+static bool ctest__reserve_trace_event(void);
+static void ctest__add_trace_event(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static const char *ctest__escape_trace_name(const char *name, char *buffer, size_t size);
+static void ctest__write_trace(const char *data, size_t size);
+
+// --- Private Variables -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief   Trace file, opened for appending so worker threads and processes write whole buffers without a lock. -1 when
+ *          no trace is written.
+ */
+static int ctest__trace_fd = -1;
+
+/**
+ * @brief   Time the trace starts at, event times are relative to it.
+ */
+static uint64_t ctest__trace_start_ns;
+
+/**
+ * @brief   Number of workers that wrote an event, each gets its own track of the timeline.
+ */
+static int ctest__trace_workers;
+
+/**
+ * @brief   Buffered events of the calling thread, allocated on its first event.
+ */
+static __thread char *ctest__trace_buffer;
+static __thread size_t ctest__trace_length;
+
+/**
+ * @brief   Track of the calling thread, 0 until it writes its first event.
+ */
+static __thread int ctest__trace_tid;
+
+// --- Public Functions Definitions ------------------------------------------------------------------------------------
+
+ctest__trace_scope_t ctest__begin_trace_scope(const char *name)
+{
+    ctest__trace_scope_t scope = {name, 0};
+    if (ctest__trace_fd >= 0)
+        scope.start_ns = ctest__get_time_ns();
+    return scope;
+}
+
+void ctest__end_trace_scope(ctest__trace_scope_t *scope)
+{
+    if (scope->start_ns != 0)
+        ctest__trace_slice(scope->name, "scope", scope->start_ns, ctest__get_time_ns(), NULL);
+}
+
+bool ctest__open_trace(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0)
+        return false;
+    ctest__trace_start_ns = ctest__get_time_ns();
+    ctest__trace_fd = fd;
+
+    // JSON array format, every event ends with a comma so workers can append them in any order
+    char event[CTEST_TRACE_EVENT_MAX];
+    int length = snprintf(event, sizeof(event),
+                          "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ctest\"}},\n",
+                          (int)getpid());
+    ctest__write_trace(event, (size_t)length);
+    return true;
+}
+
+void ctest__trace_slice(const char *name, const char *category, uint64_t start_ns, uint64_t end_ns, const char *args)
+{
+    if (ctest__trace_fd < 0 || !ctest__reserve_trace_event())
+        return;
+    char escaped[CTEST_TRACE_EVENT_MAX / 2];
+    ctest__add_trace_event("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,"
+                           "\"tid\":%d%s%s},\n",
+                           ctest__escape_trace_name(name, escaped, sizeof(escaped)), category,
+                           (double)(start_ns - ctest__trace_start_ns) / 1e3, (double)(end_ns - start_ns) / 1e3,
+                           (int)getpid(), ctest__trace_tid, args != NULL ? ",\"args\":" : "", args != NULL ? args : "");
+}
+
+void ctest__trace_fixture(const char *fixture, const char *phase, uint64_t start_ns)
+{
+    if (ctest__trace_fd < 0)
+        return;
+    char name[CTEST_TRACE_EVENT_MAX / 4];
+    snprintf(name, sizeof(name), "%s %s", phase, fixture);
+    ctest__trace_slice(name, "fixture", start_ns, ctest__get_time_ns(), NULL);
+}
+
+void ctest__flush_trace(void)
+{
+    if (ctest__trace_length > 0)
+        ctest__write_trace(ctest__trace_buffer, ctest__trace_length);
+    ctest__trace_length = 0;
+}
+
+void ctest__close_trace(void)
+{
+    if (ctest__trace_fd < 0)
+        return;
+    ctest__free_trace();
+
+    // Closing event carries no comma, which keeps the file valid JSON
+    char event[CTEST_TRACE_EVENT_MAX];
+    int length = snprintf(event, sizeof(event),
+                          "{\"name\":\"trace_end\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":%d,\"tid\":0}\n]\n",
+                          (double)(ctest__get_time_ns() - ctest__trace_start_ns) / 1e3, (int)getpid());
+    ctest__write_trace(event, (size_t)length);
+    close(ctest__trace_fd);
+    ctest__trace_fd = -1;
+}
+
+void ctest__free_trace(void)
+{
+    ctest__flush_trace();
+    ctest__pause_heap_tracking();
+    free(ctest__trace_buffer);
+    ctest__resume_heap_tracking();
+    ctest__trace_buffer = NULL;
+}
+
+// --- Private Functions Definitions -----------------------------------------------------------------------------------
+
+static bool ctest__reserve_trace_event(void)
+{
+    // Buffer of the thread is allocated with its first event, which also names its track
+    if (ctest__trace_buffer == NULL)
+    {
+        ctest__pause_heap_tracking();
+        ctest__trace_buffer = (char *)malloc(CTEST_TRACE_BUFFER_SIZE);
+        ctest__resume_heap_tracking();
+        if (ctest__trace_buffer == NULL)
+            return false;
+        if (ctest__trace_tid == 0)
+            ctest__trace_tid = __atomic_add_fetch(&ctest__trace_workers, 1, __ATOMIC_RELAXED);
+        ctest__trace_length = (size_t)snprintf(
+            ctest__trace_buffer, CTEST_TRACE_BUFFER_SIZE,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}},\n",
+            (int)getpid(), ctest__trace_tid, ctest__trace_tid);
+    }
+    if (ctest__trace_length + CTEST_TRACE_EVENT_MAX > CTEST_TRACE_BUFFER_SIZE)
+        ctest__flush_trace();
+    return true;
+}
+
+static void ctest__add_trace_event(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(&ctest__trace_buffer[ctest__trace_length], CTEST_TRACE_EVENT_MAX, format, args);
+    va_end(args);
+    if (length > 0 && length < CTEST_TRACE_EVENT_MAX)
+        ctest__trace_length += (size_t)length;
+}
+
+static const char *ctest__escape_trace_name(const char *name, char *buffer, size_t size)
+{
+    size_t length = 0;
+    for (; *name != '\0' && length + 7 < size; name++)
+    {
+        unsigned char c = (unsigned char)*name;
+        if (c == '"' || c == '\\')
+        {
+            buffer[length++] = '\\';
+            buffer[length++] = (char)c;
+        }
+        else if (c < 0x20)
+        {
+            length += (size_t)snprintf(&buffer[length], size - length, "\\u%04x", c);
+        }
+        else
+        {
+            buffer[length++] = (char)c;
+        }
+    }
+    buffer[length] = '\0';
+    return buffer;
+}
+
+static void ctest__write_trace(const char *data, size_t size)
+{
+    // Appending writes of regular files are not interleaved, so every buffer lands in the file as a whole
+    while (size > 0)
+    {
+        ssize_t written = write(ctest__trace_fd, data, size);
+        if (written <= 0)
+            break;
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+// --- EOF -------------------------------------------------------------------------------------------------------------